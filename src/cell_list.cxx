@@ -0,0 +1,69 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#include "cell_list.h"
+
+#include <limits>
+
+#include "nucleus.h"
+
+namespace trento {
+
+CellList::CellList(double cell_size)
+    : cell_size_(cell_size),
+      xmin_(0.),
+      ymin_(0.),
+      ncx_(0),
+      ncy_(0)
+{}
+
+void CellList::build(const Nucleus& nucleus) {
+  // Determine the extent of the nucleus.
+  auto xmax = -std::numeric_limits<double>::max();
+  auto ymax = -std::numeric_limits<double>::max();
+  xmin_ = ymin_ = std::numeric_limits<double>::max();
+  const auto size = nucleus.size();
+  const auto* x = nucleus.x_data();
+  const auto* y = nucleus.y_data();
+  for (std::size_t i = 0; i < size; ++i) {
+    xmin_ = std::min(xmin_, x[i]);
+    ymin_ = std::min(ymin_, y[i]);
+    xmax = std::max(xmax, x[i]);
+    ymax = std::max(ymax, y[i]);
+  }
+
+  ncx_ = static_cast<int>((xmax - xmin_)/cell_size_) + 1;
+  ncy_ = static_cast<int>((ymax - ymin_)/cell_size_) + 1;
+
+  // Counting sort of the nucleons by cell.
+  const auto ncells = static_cast<std::size_t>(ncx_*ncy_);
+  cell_start_.assign(ncells + 1, 0);
+  cell_.resize(size);
+  index_.resize(size);
+  x_.resize(size);
+  y_.resize(size);
+
+  for (std::size_t i = 0; i < size; ++i) {
+    auto cx = static_cast<int>((x[i] - xmin_)/cell_size_);
+    auto cy = static_cast<int>((y[i] - ymin_)/cell_size_);
+    cell_[i] = static_cast<std::size_t>(cy*ncx_ + cx);
+    ++cell_start_[cell_[i] + 1];
+  }
+
+  for (std::size_t c = 0; c < ncells; ++c)
+    cell_start_[c + 1] += cell_start_[c];
+
+  // Each nucleon's slot is the start of its cell plus the number of earlier
+  // nucleons in the same cell.
+  fill_.assign(cell_start_.begin(), cell_start_.end() - 1);
+  for (std::size_t i = 0; i < size; ++i) {
+    auto slot = fill_[cell_[i]]++;
+    index_[slot] = i;
+    x_[slot] = x[i];
+    y_[slot] = y[i];
+  }
+}
+
+}  // namespace trento
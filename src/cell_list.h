@@ -0,0 +1,134 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#ifndef CELL_LIST_H
+#define CELL_LIST_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "fwd_decl.h"
+
+namespace trento {
+
+/// \rst
+/// Bins the transverse positions of a nucleus into a uniform grid of square
+/// cells.  If the cell size is at least some distance *d*, every nucleon within
+/// *d* of a point lies in the 3x3 block of cells around that point, so a
+/// neighbour search need not look at the rest of the nucleus.
+///
+/// Nucleons are stored sorted by cell in row-major order, hence the three cells
+/// of each row of the block are contiguous.  Their indices and transverse
+/// positions are copied in sorted order, so each row is a contiguous slice of
+/// the ``index()``, ``x()`` and ``y()`` arrays, suitable for batched kernels.
+///
+/// Example::
+///
+///   CellList cells{max_distance};
+///   cells.build(nucleusB);
+///   cells.for_each_neighbor(x, y, [](std::size_t index) { ... });
+///   cells.for_each_neighbor_range(x, y,
+///     [&cells](std::size_t first, std::size_t last) {
+///       kernel(cells.x() + first, cells.y() + first, last - first);
+///     });
+///
+/// \endrst
+class CellList {
+ public:
+  /// Create an empty list with the given cell size.
+  explicit CellList(double cell_size);
+
+  /// Bin the current nucleon positions of a nucleus.  Must be called again
+  /// whenever the nucleus is resampled.
+  void build(const Nucleus& nucleus);
+
+  /// Call f(index) for the index (position within the nucleus) of every nucleon
+  /// in the 3x3 block of cells around the transverse point (x, y).  Returns the
+  /// number of nucleons visited.
+  template <typename F>
+  std::size_t for_each_neighbor(double x, double y, F&& f) const;
+
+  /// Call f(first, last) for each contiguous range [first, last) of sorted
+  /// positions covering the 3x3 block of cells around (x, y), skipping empty
+  /// ranges.  Returns the number of nucleons covered.
+  template <typename F>
+  std::size_t for_each_neighbor_range(double x, double y, F&& f) const;
+
+  /// Nucleon indices in sorted order.
+  const std::size_t* index() const noexcept
+  { return index_.data(); }
+
+  /// Transverse positions in sorted order.
+  const double* x() const noexcept
+  { return x_.data(); }
+  const double* y() const noexcept
+  { return y_.data(); }
+
+ private:
+  /// Side length of the cells.
+  const double cell_size_;
+
+  /// Lower edges of the grid, i.e. the minimum nucleon positions.
+  double xmin_, ymin_;
+
+  /// Number of cells in each direction.
+  int ncx_, ncy_;
+
+  /// Offset of each cell's first nucleon in index_, plus a final end offset.
+  std::vector<std::size_t> cell_start_;
+
+  /// Cell of each nucleon and next free slot of each cell (build scratch).
+  std::vector<std::size_t> cell_, fill_;
+
+  /// Nucleon indices sorted by cell.
+  std::vector<std::size_t> index_;
+
+  /// Transverse positions sorted by cell.
+  std::vector<double> x_, y_;
+};
+
+template <typename F>
+std::size_t CellList::for_each_neighbor(double x, double y, F&& f) const {
+  return for_each_neighbor_range(x, y,
+    [this, &f](std::size_t first, std::size_t last) {
+      for (auto i = first; i < last; ++i)
+        f(index_[i]);
+    });
+}
+
+template <typename F>
+std::size_t CellList::for_each_neighbor_range(
+    double x, double y, F&& f) const {
+  // Cell coordinates of the point; may lie outside the grid.
+  auto cx = static_cast<int>(std::floor((x - xmin_)/cell_size_));
+  auto cy = static_cast<int>(std::floor((y - ymin_)/cell_size_));
+
+  // Clip the 3x3 block to the grid.
+  auto cxmin = std::max(cx - 1, 0);
+  auto cxmax = std::min(cx + 1, ncx_ - 1);
+  auto cymin = std::max(cy - 1, 0);
+  auto cymax = std::min(cy + 1, ncy_ - 1);
+  if (cxmin > cxmax || cymin > cymax)
+    return 0;
+
+  std::size_t count = 0;
+  for (auto iy = cymin; iy <= cymax; ++iy) {
+    // Adjacent cells in a row are contiguous.
+    auto row = static_cast<std::size_t>(iy*ncx_);
+    auto first = cell_start_[row + static_cast<std::size_t>(cxmin)];
+    auto last = cell_start_[row + static_cast<std::size_t>(cxmax) + 1];
+    if (first == last)
+      continue;
+    f(first, last);
+    count += last - first;
+  }
+
+  return count;
+}
+
+}  // namespace trento
+
+#endif  // CELL_LIST_H
@@ -5,14 +5,23 @@
 
 #include "collider.h"
 
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <boost/program_options/variables_map.hpp>
 
+#include "cell_list.h"
 #include "fwd_decl.h"
 #include "nucleus.h"
+#include "random.h"
 #include <iostream>
 
 namespace trento {
@@ -21,13 +30,19 @@ namespace {
 
 // Helper functions for Collider ctor.
 
-// Create one nucleus from the configuration.
-NucleusPtr create_nucleus(const VarMap& var_map, std::size_t index) {
+// Create one nucleus from the configuration.  The seed is the key of the
+// engine that divides large configuration files into blocks.
+NucleusPtr create_nucleus(const VarMap& var_map, std::size_t index,
+                          random::Engine::result_type seed) {
   const auto& species = var_map["projectile"]
                         .as<std::vector<std::string>>().at(index);
   const auto& nucleon_dmin = var_map["nucleon-min-dist"].as<double>();
   const auto& nucleon_width = var_map["nucleon-width"].as<double>();
-  return Nucleus::create(species, nucleon_width, nucleon_dmin);
+  const auto& config_cache = var_map["config-cache"].as<int>();
+  if (config_cache < 0)
+    throw std::invalid_argument{"configuration cache size must be non-negative"};
+  return Nucleus::create(species, nucleon_width, nucleon_dmin,
+                         static_cast<std::size_t>(config_cache), seed);
 }
 
 // Determine the maximum impact parameter.  If the configuration contains a
@@ -54,67 +69,356 @@ double determine_asym(const Nucleus& A, const Nucleus& B) {
     return rA/sum;
 }
 
+// Add the nucleon radii proposed and accepted by a deformed nucleus (none for
+// other nuclei).
+void count_proposals(const Nucleus& nucleus,
+                     std::size_t& nproposed, std::size_t& naccepted) {
+  if (const auto* deformed =
+        dynamic_cast<const DeformedWoodsSaxonNucleus*>(&nucleus)) {
+    nproposed += deformed->nproposed();
+    naccepted += deformed->naccepted();
+  }
+}
+
+// Determine the random engine key.  Positive seeds are used as is; otherwise
+// draw a key from the hardware device.  The same key is given to every thread.
+random::Engine::result_type determine_seed(const VarMap& var_map) {
+  auto seed = var_map["random-seed"].as<int64_t>();
+  if (seed > 0)
+    return static_cast<random::Engine::result_type>(seed);
+  std::random_device device{};
+  return (static_cast<random::Engine::result_type>(device()) << 32) | device();
+}
+
+// Determine the number of event generation threads.  Zero means one thread per
+// hardware core.
+std::size_t determine_nthreads(const VarMap& var_map) {
+  auto nthreads = var_map["threads"].as<int>();
+  if (nthreads < 0)
+    throw std::invalid_argument{"number of threads must be non-negative"};
+  if (nthreads == 0)
+    return std::max(std::thread::hardware_concurrency(), 1u);
+  return static_cast<std::size_t>(nthreads);
+}
+
 }  // unnamed namespace
 
+// Everything a thread mutates while generating events.  The nuclei and the
+// nucleon profile hold sampling state and the event holds the grids, so none of
+// them can be shared between threads.
+struct Collider::Worker {
+  Worker(const VarMap& var_map, random::Engine::result_type seed)
+      : nucleusA(create_nucleus(var_map, 0, seed)),
+        nucleusB(create_nucleus(var_map, 1, seed)),
+        nucleon_profile(var_map),
+        event(var_map),
+        cellsB(nucleon_profile.max_impact()),
+        hits(nucleusB->size())
+  {}
+
+  /// Pair of nucleus projectiles.
+  NucleusPtr nucleusA, nucleusB;
+
+  /// The nucleon profile instance.
+  NucleonProfile nucleon_profile;
+
+  /// The event instance.
+  Event event;
+
+  /// Nucleus B binned in cells of size max_impact for participant sampling.
+  CellList cellsB;
+
+  /// Participation flags of a block of B nucleons, from the batched
+  /// NucleonProfile::participate().
+  std::vector<unsigned char> hits;
+
+  /// Number of trys.
+  int ntrys = 0;
+
+  /// Number of nucleon pairs passed to NucleonProfile::participate().
+  std::size_t npair_checks = 0;
+
+  /// Nucleon radii proposed and accepted by deformed nuclei that have since
+  /// been replaced by pools.
+  std::size_t nproposed = 0, naccepted = 0;
+};
+
+// Nuclei and profiles are built from the same configuration, so all workers
+// are interchangeable.
+std::vector<std::unique_ptr<Collider::Worker>>
+Collider::create_workers(const VarMap& var_map,
+                         random::Engine::result_type seed) {
+  std::vector<std::unique_ptr<Worker>> workers;
+  auto nthreads = determine_nthreads(var_map);
+  for (std::size_t i = 0; i < nthreads; ++i)
+    workers.emplace_back(new Worker{var_map, seed});
+  return workers;
+}
+
 // Lots of members to initialize...
 // Several helper functions are defined above.
 Collider::Collider(const VarMap& var_map)
-    : nucleusA_(create_nucleus(var_map, 0)),
-      nucleusB_(create_nucleus(var_map, 1)),
-      nucleon_profile_(var_map),
+    : seed_(determine_seed(var_map)),
+      workers_(create_workers(var_map, seed_)),
+      first_event_(var_map["first-event"].as<int>()),
       nevents_(var_map["number-events"].as<int>()),
-      ntrys_(0),
       bmin_(var_map["b-min"].as<double>()),
-      bmax_(determine_bmax(var_map, *nucleusA_, *nucleusB_, nucleon_profile_)),
+      bmax_(determine_bmax(var_map,
+                           *workers_.front()->nucleusA,
+                           *workers_.front()->nucleusB,
+                           workers_.front()->nucleon_profile)),
       npartmin_(var_map["npart-min"].as<int>()),
       npartmax_(var_map["npart-max"].as<int>()),
       stotmin_(var_map["s-min"].as<double>()),
       stotmax_(var_map["s-max"].as<double>()),
-      asymmetry_(determine_asym(*nucleusA_, *nucleusB_)),
-      event_(var_map),
+      asymmetry_(determine_asym(*workers_.front()->nucleusA,
+                                *workers_.front()->nucleusB)),
       output_(var_map),
-      with_ncoll_(var_map["ncoll"].as<bool>())
+      with_ncoll_(workers_.front()->event.with_ncoll()),
+      print_stats_(var_map["stats"].as<bool>()),
+      pool_size_(var_map["nucleus-pool"].as<int>())
 {
-  // Constructor body begins here.
-  // Set random seed if requested.
-  auto seed = var_map["random-seed"].as<int64_t>();
-  if (seed > 0)
-    random::engine.seed(static_cast<random::Engine::result_type>(seed));
+  if (first_event_ < 0)
+    throw std::invalid_argument{"first event number must be non-negative"};
+  if (pool_size_ < 0)
+    throw std::invalid_argument{"nucleus pool size must be non-negative"};
+  if (pool_size_ > 0)
+    create_nucleus_pools(static_cast<std::size_t>(pool_size_));
 }
 
 // See header for explanation.
 Collider::~Collider() = default;
 
+void Collider::create_nucleus_pools(std::size_t nconfigs) {
+  const auto& front = *workers_.front();
+  auto configsA = std::make_shared<NucleusPool::Configs>(
+    3*front.nucleusA->size()*nconfigs);
+  auto configsB = std::make_shared<NucleusPool::Configs>(
+    3*front.nucleusB->size()*nconfigs);
+
+  // Each worker samples every nthreads-th configuration with its own nuclei.
+  // The configurations of A and B are drawn from random streams 1 and 2
+  // (events use stream 0), so the pools do not depend on the number of
+  // threads.  The storage is allocated above, so the threads write disjoint
+  // parts of it.
+  const auto nthreads = workers_.size();
+  auto sample = [&](std::size_t i) {
+    random::engine.seed(seed_);
+    auto& worker = *workers_[i];
+    for (auto n = i; n < nconfigs; n += nthreads) {
+      NucleusPool::sample_config(*worker.nucleusA, 1, n, *configsA);
+      NucleusPool::sample_config(*worker.nucleusB, 2, n, *configsB);
+    }
+  };
+
+  if (nthreads == 1) {
+    sample(0);
+  } else {
+    // As in run_events(), record the first error and rethrow it after all
+    // threads have finished.
+    std::mutex mutex;
+    std::exception_ptr error;
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < nthreads; ++i) {
+      threads.emplace_back([&, i]() {
+        try {
+          sample(i);
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> lock{mutex};
+          if (!error)
+            error = std::current_exception();
+        }
+      });
+    }
+    for (auto&& thread : threads)
+      thread.join();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  for (auto&& worker : workers_) {
+    count_proposals(*worker->nucleusA, worker->nproposed, worker->naccepted);
+    count_proposals(*worker->nucleusB, worker->nproposed, worker->naccepted);
+    worker->nucleusA.reset(new NucleusPool{configsA, *worker->nucleusA});
+    worker->nucleusB.reset(new NucleusPool{configsB, *worker->nucleusB});
+  }
+}
+
 void Collider::run_events() {
+  const int end_event = first_event_ + nevents_;
+
+  // Serial mode: generate and write events directly in the calling thread.
+  if (workers_.size() == 1) {
+    random::engine.seed(seed_);
+    int n = first_event_;
+    run_worker(*workers_.front(),
+      [&n]() { return n++; },
+      [this](int n, double b, const Event& event) { output_(n, b, event); });
+  } else {
+    // Parallel mode: workers take the next unclaimed event number.  Since each
+    // event draws from its own random stream (see random.h), the assignment of
+    // events to threads does not affect the results.  Each finished event is
+    // written to the files right away by its worker, concurrently with the
+    // others (see Output::write_files()), so that e.g. a streamed density is
+    // computed in parallel.  Only the stdout line is held until all preceding
+    // events have been printed, then printed under the lock.  Hence the output
+    // is the same as in the serial mode, except for the order of the events in
+    // HDF5 files, and a worker never has more than one event in flight.
+    std::atomic<int> next_claim{first_event_};
+    std::mutex mutex;
+    std::condition_variable written;
+    int next_event = first_event_;
+    bool failed = false;
+    std::exception_ptr error;
+
+    auto commit = [&](int n, double b, const Event& event) {
+      output_.write_files(n, b, event);
+      std::unique_lock<std::mutex> lock{mutex};
+      written.wait(lock, [&]() { return next_event == n || failed; });
+      if (failed) {
+        // Stop handing out events so that the other workers finish promptly.
+        next_claim = end_event;
+        throw std::runtime_error{"event generation aborted"};
+      }
+      output_.write_stdout(n, b, event);
+      ++next_event;
+      written.notify_all();
+    };
+
+    const auto nthreads = workers_.size();
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < nthreads; ++i) {
+      threads.emplace_back([&, i]() {
+        // Each thread has its own engine (see random.h), all with the same key.
+        random::engine.seed(seed_);
+        try {
+          run_worker(*workers_[i], [&next_claim]() { return next_claim++; },
+                     commit);
+        }
+        catch (...) {
+          // Record the first error and release any threads waiting to commit.
+          std::lock_guard<std::mutex> lock{mutex};
+          if (!failed)
+            error = std::current_exception();
+          failed = true;
+          next_claim = end_event;
+          written.notify_all();
+        }
+      });
+    }
+
+    for (auto&& thread : threads)
+      thread.join();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+  if (print_stats_)
+    write_stats(std::cerr);
+}
+
+void Collider::write_stats(std::ostream& os) const {
+  int ntrys = 0;
+  std::size_t npair_checks = 0, nproposed = 0, naccepted = 0;
+  for (const auto& worker : workers_) {
+    ntrys += worker->ntrys;
+    npair_checks += worker->npair_checks;
+    nproposed += worker->nproposed;
+    naccepted += worker->naccepted;
+    count_proposals(*worker->nucleusA, nproposed, naccepted);
+    count_proposals(*worker->nucleusB, nproposed, naccepted);
+  }
+
+  const auto& A = *workers_.front()->nucleusA;
+  const auto& B = *workers_.front()->nucleusB;
+  const auto npairs = static_cast<double>(A.size()*B.size());
+
+  double cross_section = nevents_*M_PI*(bmax_*bmax_ - bmin_*bmin_)/ntrys;
+  double cross_section_err = cross_section/std::sqrt(1.*nevents_);
+  os << "# events          = " << nevents_ << '\n'
+     << "# tries           = " << ntrys << '\n'
+     << "# cross-section   = " << cross_section
+     << " +/- " << cross_section_err << " [fm^2]\n"
+     << "# pair checks/try = " << static_cast<double>(npair_checks)/ntrys
+     << " (of " << npairs << " pairs)\n";
+
+  // Deformed nuclei sample nucleon radii by rejection.
+  if (nproposed > 0)
+    os << "# radius accepted = "
+       << static_cast<double>(naccepted)/static_cast<double>(nproposed)
+       << " (of " << nproposed << " proposals)\n";
+
+  // Each try draws one configuration from each pool.
+  if (pool_size_ > 0) {
+    const auto& poolA = static_cast<const NucleusPool&>(A);
+    const auto& poolB = static_cast<const NucleusPool&>(B);
+    std::size_t ndraws = 0;
+    for (const auto& worker : workers_)
+      ndraws += static_cast<const NucleusPool&>(*worker->nucleusA).ndraws();
+    os << "# nucleus pools   = " << pool_size_ << " configs each, "
+       << (poolA.memory() + poolB.memory())/1048576. << " [MiB]\n"
+       << "# draws/config    = " << static_cast<double>(ndraws)/pool_size_
+       << '\n';
+  }
+}
+
+template <typename NextEvent, typename Commit>
+void Collider::run_worker(Worker& worker, NextEvent&& next, Commit&& commit) {
+  auto& event = worker.event;
+  const int end_event = first_event_ + nevents_;
+
   // The main event loop.
-  for (int n = 0; n < nevents_; ++n) {
+  for (int n = next(); n < end_event; n = next()) {
     // Sampling the impact parameter also implicitly prepares the nuclei for
     // event computation, i.e. by sampling nucleon positions and participants.
 
-    // WK: an extra do-while loop, sample events, until it meets the Npart or 
+    // WK: an extra loop, sample events, until it meets the Npart or
     // Entropy cut provided from command lines
-    bool fullfil_Npart_cut=false, fullfil_Entropy_cut=false;
+    // Every try of event n draws from random stream (n, trial), so the event
+    // can be reproduced without generating any other event.
+    // The event is computed in stages (see Event::compute()), and each cut is
+    // evaluated as soon as its stage is done, so that rejected events do not
+    // pay for e.g. the 3D extension.
     double b;
-    do{
-    	b = sample_impact_param();
-    	// Pass the prepared nuclei to the Event.  It computes the entropy profile
-    	// (thickness grid) and other event observables.
-    	event_.compute(*nucleusA_, *nucleusB_, nucleon_profile_);
-        fullfil_Npart_cut = (npartmin_ < event_.npart()) 
-								&& (event_.npart() <= npartmax_);
-        fullfil_Entropy_cut = (stotmin_ < event_.multiplicity()) 
-								&& (event_.multiplicity() <= stotmax_); 
-	}while( (!fullfil_Npart_cut) || (!fullfil_Entropy_cut) );
+    int trial = 0;
+    for (;;) {
+      b = sample_impact_param(worker, n, trial);
+      const auto& nucleusA = *worker.nucleusA;
+      const auto& nucleusB = *worker.nucleusB;
+
+      event.compute_npart(nucleusA, nucleusB);
+      if (!((npartmin_ < event.npart()) && (event.npart() <= npartmax_)))
+        continue;
+
+      // Pass the prepared nuclei to the Event.  It computes the entropy
+      // profile (thickness grid) and other event observables.
+      event.compute_thickness(nucleusA, nucleusB, worker.nucleon_profile);
+      event.compute_midrapidity();
+      if (!((stotmin_ < event.multiplicity()) &&
+            (event.multiplicity() <= stotmax_)))
+        continue;
+
+      if (with_ncoll_)
+        event.compute_collisions(nucleusA, nucleusB, worker.nucleon_profile);
+      event.compute_observables();
+      event.compute_density();
+      break;
+    }
     // Write event data.
-    output_(n, b, event_);
+    commit(n, b, event);
   }
-  double cross_section = nevents_*M_PI*(bmax_*bmax_ - bmin_*bmin_)/ntrys_;
-  double cross_section_err = cross_section/std::sqrt(1.*nevents_);
-  //std::cout << "# cross-section = " << cross_section
-  //			<< " +/- " << cross_section_err <<" [fm^2]" << std::endl; 
 }
 
-double Collider::sample_impact_param() {
+double Collider::sample_impact_param(
+    Worker& worker, int event_number, int& trial) const {
+  auto& nucleusA = *worker.nucleusA;
+  auto& nucleusB = *worker.nucleusB;
+  auto& nucleon_profile = worker.nucleon_profile;
+  auto& event = worker.event;
+
   // Sample impact parameters until at least one nucleon-nucleon pair
   // participates.  The bool 'collision' keeps track -- it is effectively a
   // logical OR over all possible participant pairs.
@@ -122,33 +426,51 @@ double Collider::sample_impact_param() {
   bool collision = false;
 
   do {
+    // Start the random stream for this try, and drop any state the fluctuation
+    // distribution carried over from the previous one.
+    random::engine.seek(static_cast<std::uint32_t>(event_number),
+                        static_cast<std::uint32_t>(trial++));
+    nucleon_profile.reset_fluctuations();
+    event.clear_collisions();
+
     // Sample b from P(b)db = 2*pi*b.
     b = bmin_ + (bmax_ - bmin_) * std::sqrt(random::canonical<double>());
 
     // Offset each nucleus depending on the asymmetry parameter (see header).
-    nucleusA_->sample_nucleons(asymmetry_ * b);
-    nucleusB_->sample_nucleons((asymmetry_ - 1.) * b);
+    nucleusA.sample_nucleons(asymmetry_ * b);
+    nucleusB.sample_nucleons((asymmetry_ - 1.) * b);
 
-    // Check each nucleon-nucleon pair.
-    for (auto&& A : *nucleusA_) {
-      for (auto&& B : *nucleusB_) {
-		bool AB_collide = nucleon_profile_.participate(A, B);
+    // Check each nucleon-nucleon pair within participation range.  Pairs
+    // farther apart than max_impact never participate, so for each A nucleon
+    // only the B nucleons in neighbouring cells need to be checked.  These are
+    // contiguous ranges of the cell list, sampled in blocks.
+    const auto& cells = worker.cellsB;
+    worker.cellsB.build(nucleusB);
+    std::size_t iA = 0;
+    for (auto&& A : nucleusA) {
+      worker.npair_checks += cells.for_each_neighbor_range(A.x(), A.y(),
+          [&](std::size_t first, std::size_t last) {
+        auto nhits = nucleon_profile.participate(
+          nucleusA, iA, nucleusB, cells.index() + first,
+          cells.x() + first, cells.y() + first, last - first,
+          worker.hits.data());
+        if (nhits == 0)
+          return;
 
+        // Record each binary collision; the Ncoll density is computed from
+        // them only if the event passes the cuts (see run_worker()).
         if (with_ncoll_) {
-			// WK: only init Ncoll and Ncoll density at the first binary collision:
-			if (AB_collide && (!collision) ) event_.clear_TAB();
-			// WK: to calculate binary collision denstiy, each collision 
-			// contribute independently its Tpp. Therefore, if one pair collide, 
-			// it calls the event object to accumulate Tpp to the Ncoll density
-			// Ncoll density = Sum Tpp		
-			if (AB_collide) event_.accumulate_TAB(A, B, nucleon_profile_);
-		}
-
-		// update collision flag
-        collision = AB_collide || collision;
-      }
+          for (auto i = first; i < last; ++i)
+            if (worker.hits[i - first])
+              event.add_collision(iA, cells.index()[i]);
+        }
+
+        // update collision flag
+        collision = true;
+      });
+      ++iA;
     }
-    ntrys_ ++;
+    worker.ntrys ++;
   } while (!collision);
 
   return b;
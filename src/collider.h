@@ -6,12 +6,15 @@
 #ifndef COLLIDER_H
 #define COLLIDER_H
 
+#include <iosfwd>
 #include <memory>
+#include <vector>
 
 #include "fwd_decl.h"
 #include "event.h"
 #include "nucleon.h"
 #include "output.h"
+#include "random.h"
 
 namespace trento {
 
@@ -21,6 +24,12 @@ namespace trento {
 /// impact parameters.  After instantiation, call ``run_events()`` to do
 /// everything.
 ///
+/// Events may be generated by several threads (option ``--threads``).  Each
+/// thread owns a complete set of the mutable objects (nuclei, nucleon profile,
+/// event, random number engine) and writes its events to files itself, while
+/// stdout is written in event-number order.  Hence the output is the same as a
+/// serial run, except that HDF5 files may store the events in another order.
+///
 /// Example::
 ///
 ///   Collider collider{var_map};
@@ -43,24 +52,48 @@ class Collider {
   /// Run events and output.
   void run_events();
 
+  /// Write run statistics (tries, cross section, work counters) to a stream.
+  void write_stats(std::ostream& os) const;
+
  private:
   // Most of these are pretty self-explanatory...
 
-  /// Sample a min-bias impact parameter within the set range.
-  double sample_impact_param();
+  /// Per-thread event generation state: a pair of nuclei, a nucleon profile
+  /// and an event.  Defined in the implementation file.
+  struct Worker;
+
+  /// Create one worker per thread as set in the configuration, with nuclei
+  /// keyed by the seed (see ManualNucleus).
+  static std::vector<std::unique_ptr<Worker>>
+  create_workers(const VarMap& var_map, random::Engine::result_type seed);
+
+  /// Generate the events numbered by successive calls of next() and pass each
+  /// one to the commit function, which writes them in order.
+  template <typename NextEvent, typename Commit>
+  void run_worker(Worker& worker, NextEvent&& next, Commit&& commit);
+
+  /// Replace the nuclei of every worker by pools of the given number of
+  /// configurations sampled from them (see NucleusPool), one pool per
+  /// projectile shared by all workers.  The workers sample the configurations
+  /// in parallel.
+  void create_nucleus_pools(std::size_t nconfigs);
+
+  /// Sample a min-bias impact parameter within the set range.  Each try draws
+  /// from the random stream (event_number, trial) and increments trial.
+  double sample_impact_param(Worker& worker, int event_number, int& trial) const;
 
-  /// Pair of nucleus projectiles.
-  std::unique_ptr<Nucleus> nucleusA_, nucleusB_;
+  /// Key of the counter-based random engine.
+  const random::Engine::result_type seed_;
 
-  /// The nucleon profile instance.
-  NucleonProfile nucleon_profile_;
+  /// Per-thread generators; there is always at least one.
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  /// Number of the first event; events are numbered consecutively from here.
+  const int first_event_;
 
   /// Number of events to run.
   const int nevents_;
 
-  /// Number of trys.
-  int ntrys_;
-
   /// Minimum and maximum impact parameter.
   const double bmin_, bmax_;
 
@@ -88,14 +121,18 @@ class Collider {
   /// entire impact parameter and the proton would not be offset at all.
   const double asymmetry_;
 
-  /// The event instance.
-  Event event_;
-
   /// The output instance.
   Output output_;
 
-  /// Whether calculate Ncoll and nulear binary collision density
+  /// Whether calculate Ncoll and record the binary collisions (see
+  /// Event::with_ncoll())
   bool with_ncoll_;
+
+  /// Whether to write run statistics to stderr after the events.
+  const bool print_stats_;
+
+  /// Number of configurations of each nucleus pool (zero if none).
+  const int pool_size_;
 };
 
 }  // namespace trento
@@ -8,10 +8,16 @@
 #include <algorithm>
 #include <cmath>
 
+#include <boost/math/constants/constants.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <gsl/gsl_fft_complex.h>
+#include "fast_math.h"
 #include "nucleus.h"
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <stdexcept>
+#include <string>
 
 namespace trento {
 
@@ -19,25 +25,74 @@ namespace {
 
 constexpr double TINY = 1e-12;
 
+// Number of tabulated rapidity profile shapes, and the thickness difference
+// TA - TB [fm^-2] up to which they cover absolute skew.
+constexpr std::size_t skew_table_size = 1001;
+constexpr double absolute_skew_table_range = 10.;
+
+// Number of cells per block of the eccentricity moment loops, and of
+// independent partial sums of the reduced thickness.
+constexpr int moment_block = 64;
+constexpr int sum_lanes = 8;
+
+// Highest harmonic order accepted by --harmonics.  Each order up to the highest
+// one requested costs a complex multiply per cell.
+constexpr int max_harmonic = 20;
+
+// The generalized means are applied to whole rows of the grid, so they are
+// written without branches (conditions enter as 0/1 factors) to let the
+// compiler vectorize the loop.  Common values of p have their own closed forms.
+
 // Generalized mean for p > 0.
 // M_p(a, b) = (1/2*(a^p + b^p))^(1/p)
+// Zero thickness contributes zero.  fast_pow() is inaccurate but finite at
+// zero, so mask its result.
 inline double positive_pmean(double p, double a, double b) {
-  return std::pow(.5*(std::pow(a, p) + std::pow(b, p)), 1./p);
+  auto ap = (a > 0.)*fast_pow(a, p);
+  auto bp = (b > 0.)*fast_pow(b, p);
+  auto sum = .5*(ap + bp);
+  return (sum > 0.)*fast_pow(sum, 1./p);
 }
 
 // Generalized mean for p < 0.
-// Same as the positive version, except prevents division by zero.
+// Same as the positive version, except vanishes if either argument does.
 inline double negative_pmean(double p, double a, double b) {
-  if (a < TINY || b < TINY)
-    return 0.;
-  return positive_pmean(p, a, b);
+  auto ap = fast_pow(a, p);
+  auto bp = fast_pow(b, p);
+  auto mean = fast_pow(.5*(ap + bp), 1./p);
+  return (a >= TINY)*(b >= TINY)*mean;
+}
+
+// The closed forms are evaluated in the grid precision (see
+// Event::GridElement); the others need double for fast_pow().
+
+// Generalized mean for p == 1.
+template <typename T>
+inline T arithmetic_mean(T a, T b) {
+  return T(.5)*(a + b);
+}
+
+// Generalized mean for p == 1/2.
+template <typename T>
+inline T sqrt_mean(T a, T b) {
+  auto s = T(.5)*(std::sqrt(a) + std::sqrt(b));
+  return s*s;
 }
 
 // Generalized mean for p == 0.
-inline double geometric_mean(double a, double b) {
+template <typename T>
+inline T geometric_mean(T a, T b) {
   return std::sqrt(a*b);
 }
 
+// Generalized mean for p == -1.
+template <typename T>
+inline T harmonic_mean(T a, T b) {
+  const auto tiny = static_cast<T>(TINY);
+  auto mean = T(2)*a*b/std::max(a + b, tiny);
+  return T((a >= tiny)*(b >= tiny))*mean;
+}
+
 // Get beam rapidity from beam energy sqrt(s)
 double beam_rapidity(double beam_energy) {
   // Proton mass in GeV
@@ -45,6 +100,46 @@ double beam_rapidity(double beam_energy) {
   return 0.5 * (beam_energy/mp + std::sqrt(std::pow(beam_energy/mp, 2) - 4.));
 }
 
+// Parse a list of harmonic orders such as "2-5" or "1,2,4-6" into sorted,
+// unique values.
+std::vector<int> parse_harmonics(const std::string& list) {
+  auto error = [&list]() {
+    return std::invalid_argument{"invalid harmonics: " + list};
+  };
+
+  std::vector<int> harmonics;
+  std::istringstream stream{list};
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    int first, last;
+    char dash;
+    std::istringstream item_stream{item};
+    if (!(item_stream >> first))
+      throw error();
+    if (item_stream >> dash) {
+      if (dash != '-' || !(item_stream >> last))
+        throw error();
+    } else {
+      last = first;
+    }
+    if (!(item_stream >> std::ws).eof() || first < 1 || last < first)
+      throw error();
+    if (last > max_harmonic)
+      throw std::invalid_argument{
+        "harmonic order above " + std::to_string(max_harmonic) + ": " + list};
+    for (int n = first; n <= last; ++n)
+      harmonics.push_back(n);
+  }
+
+  if (harmonics.empty())
+    throw error();
+
+  std::sort(harmonics.begin(), harmonics.end());
+  harmonics.erase(std::unique(harmonics.begin(), harmonics.end()),
+                  harmonics.end());
+  return harmonics;
+}
+
 }  // unnamed namespace
 
 // Determine the grid parameters like so:
@@ -74,8 +169,30 @@ Event::Event(const VarMap& var_map)
       TB_(boost::extents[nsteps_][nsteps_]),
       TR_(boost::extents[nsteps_][nsteps_][1]),
 	  TAB_(boost::extents[nsteps_][nsteps_]),
-      with_ncoll_(var_map["ncoll"].as<bool>()),
-      density_(boost::extents[nsteps_][nsteps_][neta_]) {
+      overlap_only_(var_map["reduced-thickness"].as<double>() < TINY),
+      dxsq_(static_cast<std::size_t>(nsteps_)),
+      dysq_(static_cast<std::size_t>(nsteps_)),
+      gauss_x_(static_cast<std::size_t>(nsteps_)),
+      gauss_y_(static_cast<std::size_t>(nsteps_)),
+      fft_pad_(0),
+      fft_size_(0),
+      mid_jacobian_(is3D() ? eta2y_.Jacobian(0.) : 1.),
+      stream_density_(is3D() && var_map["stream-density"].as<bool>()),
+      no_density_(var_map["no-density"].as<bool>()),
+      harmonics_(parse_harmonics(var_map["harmonics"].as<std::string>())),
+      radial_weight_(var_map["radial-weight"].as<int>()),
+      ecc_vectors_(harmonics_.size()),
+      eccentricity_(harmonics_.size()),
+      psi_(harmonics_.size()),
+      moment_sums_(3*harmonics_.size()*moment_block),
+      tr_cells_(static_cast<std::size_t>(nsteps_*nsteps_)),
+      eta_observables_(is3D() && var_map["eta-observables"].as<bool>()),
+      eta_pending_(false),
+      visiting_rows_(false),
+      with_ncoll_(var_map["ncoll"].as<bool>() ||
+                  var_map["collision-vertices"].as<bool>()),
+      with_ncoll_density_(var_map["ncoll"].as<bool>()),
+      with_vertices_(var_map["collision-vertices"].as<bool>()) {
   // Check if the skew parameter is within the applicable range
   // For 1: relative skew, skew_coeff_ < 10.
   //	 2: absolute skew, skew_coeff_ < 3.
@@ -93,13 +210,111 @@ Event::Event(const VarMap& var_map)
     exit(1);
   }
 
+  // Store the 3D density, or buffer one row of it if it is streamed or not
+  // output.  In 2D mode the density is TR.
+  if (stream_density_ || (is3D() && no_density_))
+    density_row_.resize(static_cast<std::size_t>(nsteps_*neta_));
+  else if (is3D())
+    density_.resize(boost::extents[nsteps_][nsteps_][neta_]);
+
+  tr_spans_.reserve(static_cast<std::size_t>(nsteps_));
+
+  if (eta_observables_) {
+    const auto neta = static_cast<std::size_t>(neta_);
+    const auto nh = harmonics_.size();
+    eta_multiplicity_.resize(neta);
+    eta_ecc_vectors_.resize(nh*neta);
+    eta_eccentricity_.resize(nh*neta);
+    eta_psi_.resize(nh*neta);
+    eta_decorrelation_.resize(nh*neta);
+    eta_sums_.resize((3*nh + 1)*neta);
+    eta_factors_.resize(3*nh);
+  }
+
+  // Tabulate the rapidity profile shapes over the range of skew values the
+  // events can produce, unless exact transforms are requested.  Relative skew
+  // is bounded by the coefficient; for absolute skew, cover thickness
+  // differences up to absolute_skew_table_range and transform the rare larger
+  // values exactly.
+  if (is3D() && !var_map["exact-rapidity"].as<bool>()) {
+    auto skew_range = std::fabs(skew_coeff_);
+    if (skew_type_ == absolute_skew_switch)
+      skew_range *= absolute_skew_table_range;
+    else if (skew_type_ != relative_skew_switch)
+      skew_range = 0.;
+    cgf_.tabulate(skew_range, skew_table_size);
+  }
+
+  // Choose the deposition kernel.  All are declared in the header.
+  const auto& deposition = var_map["deposition"].as<std::string>();
+  if (deposition == "direct") {
+    compute_thickness_grids_ = [this](const Nucleus& nucleusA,
+        const Nucleus& nucleusB, NucleonProfile& profile) {
+      auto deposit = [this](double x, double y,
+                            int ixmin, int ixmax, int iymin, int iymax,
+                            const NucleonProfile& profile, Grid& TX) {
+        deposit_direct(x, y, ixmin, ixmax, iymin, iymax, profile, TX);
+      };
+      compute_nuclear_thickness(nucleusA, profile, TA_, region_A_, deposit);
+      compute_nuclear_thickness(nucleusB, profile, TB_, region_B_, deposit);
+    };
+  } else if (deposition == "separable") {
+    compute_thickness_grids_ = [this](const Nucleus& nucleusA,
+        const Nucleus& nucleusB, NucleonProfile& profile) {
+      auto deposit = [this](double x, double y,
+                            int ixmin, int ixmax, int iymin, int iymax,
+                            const NucleonProfile& profile, Grid& TX) {
+        deposit_separable(x, y, ixmin, ixmax, iymin, iymax, profile, TX);
+      };
+      compute_nuclear_thickness(nucleusA, profile, TA_, region_A_, deposit);
+      compute_nuclear_thickness(nucleusB, profile, TB_, region_B_, deposit);
+    };
+  } else if (deposition == "stamp") {
+    compute_thickness_grids_ = [this](const Nucleus& nucleusA,
+        const Nucleus& nucleusB, NucleonProfile& profile) {
+      auto deposit = [this](double x, double y,
+                            int ixmin, int ixmax, int iymin, int iymax,
+                            const NucleonProfile& profile, Grid& TX) {
+        deposit_stamp(x, y, ixmin, ixmax, iymin, iymax, profile, TX);
+      };
+      compute_nuclear_thickness(nucleusA, profile, TA_, region_A_, deposit);
+      compute_nuclear_thickness(nucleusB, profile, TB_, region_B_, deposit);
+    };
+  } else if (deposition == "fft") {
+    init_fft(var_map["nucleon-width"].as<double>());
+    compute_thickness_grids_ = [this](const Nucleus& nucleusA,
+        const Nucleus& nucleusB, NucleonProfile& profile) {
+      compute_thickness_grids_fft(nucleusA, nucleusB, profile);
+    };
+  } else {
+    throw std::invalid_argument{"unknown deposition kernel: " + deposition};
+  }
+
   // Choose which version of the generalized mean to use based on the
   // configuration. The possibilities are defined above.  See the header for
-  // more information.
+  // more information.  Each is wrapped in a lambda (a distinct type) rather
+  // than passed as a function pointer, so that it is inlined into its own
+  // instantiation of the loop.
   auto p = var_map["reduced-thickness"].as<double>();
   if (std::fabs(p) < TINY) {
     compute_reduced_thickness_ = [this]() {
-      compute_reduced_thickness(geometric_mean);
+      compute_reduced_thickness(
+        [](GridElement a, GridElement b) { return geometric_mean(a, b); });
+    };
+  } else if (std::fabs(p - 1.) < TINY) {
+    compute_reduced_thickness_ = [this]() {
+      compute_reduced_thickness(
+        [](GridElement a, GridElement b) { return arithmetic_mean(a, b); });
+    };
+  } else if (std::fabs(p - .5) < TINY) {
+    compute_reduced_thickness_ = [this]() {
+      compute_reduced_thickness(
+        [](GridElement a, GridElement b) { return sqrt_mean(a, b); });
+    };
+  } else if (std::fabs(p + 1.) < TINY) {
+    compute_reduced_thickness_ = [this]() {
+      compute_reduced_thickness(
+        [](GridElement a, GridElement b) { return harmonic_mean(a, b); });
     };
   } else if (p > 0.) {
     compute_reduced_thickness_ = [this, p]() {
@@ -116,12 +331,31 @@ Event::Event(const VarMap& var_map)
 
 void Event::compute(const Nucleus& nucleusA, const Nucleus& nucleusB,
                     NucleonProfile& profile) {
-  // Reset npart; compute_nuclear_thickness() increments it.
+  compute_npart(nucleusA, nucleusB);
+  compute_thickness(nucleusA, nucleusB, profile);
+  compute_midrapidity();
+  compute_observables();
+  compute_density();
+  if (with_ncoll_)
+    compute_collisions(nucleusA, nucleusB, profile);
+}
+
+void Event::compute_npart(const Nucleus& nucleusA, const Nucleus& nucleusB) {
   npart_ = 0;
-  compute_nuclear_thickness(nucleusA, profile, TA_);
-  compute_nuclear_thickness(nucleusB, profile, TB_);
+  for (const auto* nucleus : {&nucleusA, &nucleusB})
+    for (const auto& nucleon : *nucleus)
+      if (nucleon.is_participant())
+        ++npart_;
+}
+
+void Event::compute_thickness(const Nucleus& nucleusA,
+                              const Nucleus& nucleusB,
+                              NucleonProfile& profile) {
+  compute_thickness_grids_(nucleusA, nucleusB, profile);
+}
+
+void Event::compute_midrapidity() {
   compute_reduced_thickness_();
-  compute_observables();
 }
 
 bool Event::is3D() const {
@@ -141,58 +375,106 @@ inline const T& clip(const T& value, const T& min, const T& max) {
   return value;
 }
 
+// Set the cells [ixmin, ixmax] x [iymin, iymax] of a 2D or 3D grid to zero.
+// The cells of a row, including any trailing dimension, are contiguous.
+template <typename Array>
+void zero_cells(Array& grid, int ixmin, int ixmax, int iymin, int iymax) {
+  if (ixmin > ixmax || iymin > iymax)
+    return;
+  const auto row_stride = grid.strides()[0];
+  const auto cell_stride = grid.strides()[1];
+  const auto count = (ixmax - ixmin + 1)*cell_stride;
+  for (auto iy = iymin; iy <= iymax; ++iy)
+    std::fill_n(grid.origin() + iy*row_stride + ixmin*cell_stride, count, 0.);
+}
+
 }  // unnamed namespace
 
-// WK: clear Ncoll density table
-void Event::clear_TAB(void){
-  ncoll_ = 0;
-  for (int iy = 0; iy < nsteps_; ++iy) {
-    for (int ix = 0; ix < nsteps_; ++ix) {
-      TAB_[iy][ix] = 0.;
+void Event::compute_collisions(const Nucleus& nucleusA,
+                               const Nucleus& nucleusB,
+                               const NucleonProfile& profile) {
+  const auto A_begin = nucleusA.begin();
+  const auto B_begin = nucleusB.begin();
+
+  if (with_vertices_) {
+    vertices_.clear();
+    vertices_.reserve(3*collisions_.size());
+    for (const auto& collision : collisions_) {
+      const auto& A =
+        *(A_begin + static_cast<std::ptrdiff_t>(collision.first));
+      const auto& B =
+        *(B_begin + static_cast<std::ptrdiff_t>(collision.second));
+      vertices_.push_back(.5*(A.x() + B.x()));
+      vertices_.push_back(.5*(A.y() + B.y()));
+      vertices_.push_back(std::hypot(A.x() - B.x(), A.y() - B.y()));
     }
   }
+
+  if (!with_ncoll_density_)
+    return;
+
+  // Wipe the previous event with zeros.
+  zero_cells(TAB_, region_TAB_.ixmin, region_TAB_.ixmax,
+             region_TAB_.iymin, region_TAB_.iymax);
+  region_TAB_ = Region{};
+
+  // Each binary collision contributes the product of the two (unfluctuated)
+  // nucleon profiles normalized to one collision, T(rA) T(rB) / Tpp(b).  For
+  // Gaussian profiles, that is a single narrower Gaussian about the midpoint of
+  // the pair (see NucleonProfile::binary_collision_factor()), so deposit one
+  // profile there, separably like deposit_separable().
+  for (const auto& collision : collisions_) {
+    const auto& A = *(A_begin + static_cast<std::ptrdiff_t>(collision.first));
+    const auto& B = *(B_begin + static_cast<std::ptrdiff_t>(collision.second));
+    deposit_binary_collision(.5*(A.x() + B.x()) + xymax_,
+                             .5*(A.y() + B.y()) + xymax_, profile);
+  }
 }
 
-// WK: accumulate a Tpp to Ncoll density table
-void Event::accumulate_TAB(Nucleon& A, Nucleon& B, NucleonProfile& profile){
-    ncoll_ ++;
-	// the loaction of A and B nucleon
-	double xA = A.x() + xymax_, yA = A.y() + xymax_;
-	double xB = B.x() + xymax_, yB = B.y() + xymax_;
-	// impact parameter squared of this binary collision
-	double bpp_sq = std::pow(xA - xB, 2) + std::pow(yA - yB, 2);
-	// the mid point of A and B
-	double x = (xA+xB)/2.;
-    double y = (yA+yB)/2.;
-	// the max radius of Tpp 
-	const double r = profile.radius();
-	int ixmin = clip(static_cast<int>((x-r)/dxy_), 0, nsteps_-1);
-    int iymin = clip(static_cast<int>((y-r)/dxy_), 0, nsteps_-1);
-    int ixmax = clip(static_cast<int>((x+r)/dxy_), 0, nsteps_-1);
-    int iymax = clip(static_cast<int>((y+r)/dxy_), 0, nsteps_-1);
+void Event::deposit_binary_collision(double x, double y,
+                                     const NucleonProfile& profile) {
+  const auto rsq = profile.binary_collision_radius_sqr();
+  const auto r = std::sqrt(rsq);
+  const int ixmin = clip(static_cast<int>((x-r)/dxy_), 0, nsteps_-1);
+  const int iymin = clip(static_cast<int>((y-r)/dxy_), 0, nsteps_-1);
+  const int ixmax = clip(static_cast<int>((x+r)/dxy_), 0, nsteps_-1);
+  const int iymax = clip(static_cast<int>((y+r)/dxy_), 0, nsteps_-1);
+  region_TAB_.cover(ixmin, ixmax, iymin, iymax);
 
-    // Add Tpp to Ncoll density.
-	auto norm_Tpp = profile.norm_Tpp(bpp_sq);
-    for (auto iy = iymin; iy <= iymax; ++iy) {
-      double dysqA = std::pow(yA - (static_cast<double>(iy)+.5)*dxy_, 2);
-	  double dysqB = std::pow(yB - (static_cast<double>(iy)+.5)*dxy_, 2);
-      for (auto ix = ixmin; ix <= ixmax; ++ix) {
-        double dxsqA = std::pow(xA - (static_cast<double>(ix)+.5)*dxy_, 2);
-		double dxsqB = std::pow(xB - (static_cast<double>(ix)+.5)*dxy_, 2);
-		// The Ncoll density does not fluctuates, so we use the 
-		// deterministic_thickness function
-		// where the Gamma fluctuation are turned off.
-		// since this binary collision already happened, the binary collision
-		// density should be normalized to one.
-        TAB_[iy][ix] += profile.deterministic_thickness(dxsqA + dysqA)
-						* profile.deterministic_thickness(dxsqB + dysqB)
-						/ norm_Tpp;
-      }
-    }
+  auto* dxsq = dxsq_.data();
+  auto* dysq = dysq_.data();
+  auto* gauss_x = gauss_x_.data();
+  auto* gauss_y = gauss_y_.data();
+
+  for (auto ix = ixmin; ix <= ixmax; ++ix) {
+    dxsq[ix] = std::pow(x - (static_cast<double>(ix)+.5)*dxy_, 2);
+    gauss_x[ix] = profile.binary_collision_factor(dxsq[ix]);
+  }
+  const auto prefactor = profile.binary_collision_prefactor();
+  for (auto iy = iymin; iy <= iymax; ++iy) {
+    dysq[iy] = std::pow(y - (static_cast<double>(iy)+.5)*dxy_, 2);
+    gauss_y[iy] = prefactor * profile.binary_collision_factor(dysq[iy]);
+  }
+
+  for (auto iy = iymin; iy <= iymax; ++iy) {
+    auto dxsq_max = rsq - dysq[iy];
+    auto ixlo = ixmin, ixhi = ixmax;
+    while (ixlo <= ixhi && dxsq[ixlo] > dxsq_max)
+      ++ixlo;
+    while (ixhi >= ixlo && dxsq[ixhi] > dxsq_max)
+      --ixhi;
+
+    auto* row = &TAB_[iy][0];
+    const auto gy = gauss_y[iy];
+    for (auto ix = ixlo; ix <= ixhi; ++ix)
+      row[ix] += gy * gauss_x[ix];
+  }
 }
 
+template <typename Deposit>
 void Event::compute_nuclear_thickness(
-    const Nucleus& nucleus, NucleonProfile& profile, Grid& TX) {
+    const Nucleus& nucleus, NucleonProfile& profile, Grid& TX,
+    Region& region, Deposit deposit) {
   // Construct the thickness grid by looping over participants and adding each
   // to a small subgrid within its radius.  Compared to the other possibility
   // (grid cells as the outer loop and participants as the inner loop), this
@@ -200,8 +482,9 @@ void Event::compute_nuclear_thickness(
   // ~20 (depending on the nucleon size).  The Event unit test verifies that the
   // two methods agree.
 
-  // Wipe grid with zeros.
-  std::fill(TX.origin(), TX.origin() + TX.num_elements(), 0.);
+  // Wipe the previous event with zeros.
+  zero_cells(TX, region.ixmin, region.ixmax, region.iymin, region.iymax);
+  region = Region{};
 
   const double r = profile.radius();
 
@@ -210,8 +493,6 @@ void Event::compute_nuclear_thickness(
     if (!nucleon.is_participant())
       continue;
 
-    ++npart_;
-
     // Work in coordinates relative to (-width/2, -width/2).
     double x = nucleon.x() + xymax_;
     double y = nucleon.y() + xymax_;
@@ -226,51 +507,333 @@ void Event::compute_nuclear_thickness(
     profile.fluctuate();
 
     // Add profile to grid.
-    for (auto iy = iymin; iy <= iymax; ++iy) {
-      double dysq = std::pow(y - (static_cast<double>(iy)+.5)*dxy_, 2);
-      for (auto ix = ixmin; ix <= ixmax; ++ix) {
-        double dxsq = std::pow(x - (static_cast<double>(ix)+.5)*dxy_, 2);
-        TX[iy][ix] += profile.thickness(dxsq + dysq);
-      }
+    deposit(x, y, ixmin, ixmax, iymin, iymax, profile, TX);
+    region.cover(ixmin, ixmax, iymin, iymax);
+  }
+}
+
+void Event::deposit_direct(double x, double y,
+                           int ixmin, int ixmax, int iymin, int iymax,
+                           const NucleonProfile& profile, Grid& TX) const {
+  for (auto iy = iymin; iy <= iymax; ++iy) {
+    double dysq = std::pow(y - (static_cast<double>(iy)+.5)*dxy_, 2);
+    for (auto ix = ixmin; ix <= ixmax; ++ix) {
+      double dxsq = std::pow(x - (static_cast<double>(ix)+.5)*dxy_, 2);
+      TX[iy][ix] += profile.thickness(dxsq + dysq);
+    }
+  }
+}
+
+void Event::deposit_separable(double x, double y,
+                              int ixmin, int ixmax, int iymin, int iymax,
+                              const NucleonProfile& profile, Grid& TX) {
+  auto* dxsq = dxsq_.data();
+  auto* dysq = dysq_.data();
+  auto* gauss_x = gauss_x_.data();
+  auto* gauss_y = gauss_y_.data();
+
+  // exp(-(dx^2 + dy^2)/2w^2) = exp(-dx^2/2w^2) * exp(-dy^2/2w^2), so tabulate
+  // one factor per column and per row; the prefactor goes with the rows.
+  for (auto ix = ixmin; ix <= ixmax; ++ix) {
+    dxsq[ix] = std::pow(x - (static_cast<double>(ix)+.5)*dxy_, 2);
+    gauss_x[ix] = profile.gaussian_factor(dxsq[ix]);
+  }
+  const auto prefactor = profile.prefactor();
+  for (auto iy = iymin; iy <= iymax; ++iy) {
+    dysq[iy] = std::pow(y - (static_cast<double>(iy)+.5)*dxy_, 2);
+    gauss_y[iy] = prefactor * profile.gaussian_factor(dysq[iy]);
+  }
+
+  // Like NucleonProfile::thickness(), the profile vanishes outside the
+  // truncation radius.  Within each row, that is a contiguous range of columns
+  // around the nucleon, found by shrinking the subgrid row from both ends.
+  const auto rsq = profile.radius_sqr();
+  for (auto iy = iymin; iy <= iymax; ++iy) {
+    auto dxsq_max = rsq - dysq[iy];
+    auto ixlo = ixmin, ixhi = ixmax;
+    while (ixlo <= ixhi && dxsq[ixlo] > dxsq_max)
+      ++ixlo;
+    while (ixhi >= ixlo && dxsq[ixhi] > dxsq_max)
+      --ixhi;
+
+    auto* row = &TX[iy][0];
+    const auto gy = gauss_y[iy];
+    for (auto ix = ixlo; ix <= ixhi; ++ix)
+      row[ix] += gy * gauss_x[ix];
+  }
+}
+
+void Event::deposit_stamp(double x, double y,
+                          int ixmin, int ixmax, int iymin, int iymax,
+                          const NucleonProfile& profile, Grid& TX) const {
+  // Round a coordinate to the nearest stamp phase, i.e. write it (in units of
+  // cells, relative to cell centers) as i0 + phase/nphases.  Return i0 - K,
+  // the grid index of the first stamp cell.
+  const auto nphases = profile.stamp_phases();
+  const auto K = profile.stamp_half_width();
+  auto locate = [this, nphases, K](double x, int& phase) {
+    auto u = x/dxy_ - .5;
+    auto i0 = static_cast<int>(std::floor(u));
+    phase = static_cast<int>((u - i0)*nphases + .5);
+    if (phase == nphases) {
+      ++i0;
+      phase = 0;
+    }
+    return i0 - K;
+  };
+
+  // The stamps cover [i0 - K, i0 + K + 1], a superset of the subgrid.
+  int px, py;
+  const auto jx0 = locate(x, px);
+  const auto jy0 = locate(y, py);
+  const auto* sx = profile.stamp(px) - jx0;
+  const auto* sy = profile.stamp(py) - jy0;
+  const auto* dxsq = profile.stamp_distance_sqr(px) - jx0;
+  const auto* dysq = profile.stamp_distance_sqr(py) - jy0;
+
+  // Truncate at the profile radius as in the separable kernel.
+  const auto rsq = profile.radius_sqr();
+  const auto prefactor = profile.prefactor();
+  for (auto iy = iymin; iy <= iymax; ++iy) {
+    auto dxsq_max = rsq - dysq[iy];
+    auto ixlo = ixmin, ixhi = ixmax;
+    while (ixlo <= ixhi && dxsq[ixlo] > dxsq_max)
+      ++ixlo;
+    while (ixhi >= ixlo && dxsq[ixhi] > dxsq_max)
+      --ixhi;
+
+    auto* row = &TX[iy][0];
+    const auto gy = prefactor * sy[iy];
+    for (auto ix = ixlo; ix <= ixhi; ++ix)
+      row[ix] += gy * sx[ix];
+  }
+}
+
+void Event::init_fft(double nucleon_width) {
+  // Pad by the profile truncation radius (plus one cell for the splat) so that
+  // every participant that reaches the grid is splatted inside the padded
+  // grid, and the periodic wrap-around of the convolution only mixes in
+  // contributions from beyond the truncation radius.
+  fft_pad_ = static_cast<int>(std::ceil(5.*nucleon_width/dxy_)) + 1;
+  fft_size_ = 1;
+  while (fft_size_ < nsteps_ + 2*fft_pad_)
+    fft_size_ *= 2;
+
+  // Gaussian transform divided by the tent transform, per axis.  Wave numbers
+  // above N/2 are negative frequencies.
+  const auto n = static_cast<std::size_t>(fft_size_);
+  std::vector<double> factor(n);
+  const auto wsq = nucleon_width*nucleon_width;
+  for (std::size_t k = 0; k < n; ++k) {
+    auto kk = (k < n/2) ? static_cast<double>(k) : static_cast<double>(k) - n;
+    auto q = math::double_constants::two_pi*kk/(fft_size_*dxy_);
+    auto half = .5*q*dxy_;
+    auto sinc = (k == 0) ? 1. : std::sin(half)/half;
+    factor[k] = std::exp(-.5*wsq*q*q)/(sinc*sinc);
+  }
+
+  // Poisson summation: the DFT of exp(-r^2/2w^2) sampled on the grid is
+  // 2*pi*w^2/dxy^2 times the continuous transform.  Also absorb the 1/N^2
+  // normalization of the backward transform.
+  const auto norm = math::double_constants::two_pi*wsq/(dxy_*dxy_)/(n*n);
+  fft_kernel_.resize(n*n);
+  for (std::size_t ky = 0; ky < n; ++ky)
+    for (std::size_t kx = 0; kx < n; ++kx)
+      fft_kernel_[ky*n + kx] = norm*factor[ky]*factor[kx];
+
+  fft_data_.resize(2*n*n);
+}
+
+void Event::compute_thickness_grids_fft(const Nucleus& nucleusA,
+                                        const Nucleus& nucleusB,
+                                        NucleonProfile& profile) {
+  const auto n = static_cast<std::size_t>(fft_size_);
+  std::fill(fft_data_.begin(), fft_data_.end(), 0.);
+
+  // Splat each participant onto the four nearest cell centers of the padded
+  // grid; nucleus A into the real parts and B into the imaginary parts.  The
+  // participants are visited (and their profiles fluctuated) in the same
+  // order as by the other engines.
+  // Also track the padded cells splatted by each nucleus.
+  int iymin = fft_size_, iymax = -1;
+  Region splatted[2];
+  auto splat = [this, n, &profile, &iymin, &iymax, &splatted](
+      const Nucleus& nucleus, std::size_t part) {
+    for (const auto& nucleon : nucleus) {
+      if (!nucleon.is_participant())
+        continue;
+
+      profile.fluctuate();
+
+      // Continuous cell index relative to the cell centers.
+      auto u = (nucleon.x() + xymax_)/dxy_ - .5 + fft_pad_;
+      auto v = (nucleon.y() + xymax_)/dxy_ - .5 + fft_pad_;
+      auto ix = static_cast<int>(std::floor(u));
+      auto iy = static_cast<int>(std::floor(v));
+
+      // Too far from the grid to contribute.
+      if (ix < 0 || iy < 0 || ix + 1 >= fft_size_ || iy + 1 >= fft_size_)
+        continue;
+
+      iymin = std::min(iymin, iy);
+      iymax = std::max(iymax, iy + 1);
+      splatted[part].cover(ix, ix + 1, iy, iy + 1);
+
+      auto fx = u - ix;
+      auto fy = v - iy;
+      auto weight = profile.prefactor();
+      auto* cell = fft_data_.data() + part +
+        2*(static_cast<std::size_t>(iy)*n + static_cast<std::size_t>(ix));
+      cell[0] += weight*(1. - fx)*(1. - fy);
+      cell[2] += weight*fx*(1. - fy);
+      cell[2*n] += weight*(1. - fx)*fy;
+      cell[2*n + 2] += weight*fx*fy;
     }
+  };
+  splat(nucleusA, 0);
+  splat(nucleusB, 1);
+
+  // The thickness reaches at most the padding width (the truncation radius)
+  // beyond the splatted cells; the convolution leaves only round-off outside.
+  // In grid indices, splatted cell i is i - fft_pad_.
+  auto reach = [this](const Region& s) {
+    Region r;
+    if (!s.empty())
+      r.cover(clip(s.ixmin - 2*fft_pad_, 0, nsteps_-1),
+              clip(s.ixmax, 0, nsteps_-1),
+              clip(s.iymin - 2*fft_pad_, 0, nsteps_-1),
+              clip(s.iymax, 0, nsteps_-1));
+    return r;
+  };
+  zero_cells(TA_, region_A_.ixmin, region_A_.ixmax,
+             region_A_.iymin, region_A_.iymax);
+  zero_cells(TB_, region_B_.ixmin, region_B_.ixmax,
+             region_B_.iymin, region_B_.iymax);
+  region_A_ = reach(splatted[0]);
+  region_B_ = reach(splatted[1]);
+  Region rows = region_A_;
+  if (!region_B_.empty())
+    rows.cover(region_B_.ixmin, region_B_.ixmax,
+               region_B_.iymin, region_B_.iymax);
+
+  // 2D transform as rows then columns, multiply by the kernel, and transform
+  // back.  Rows without participants transform to zero, and only the rows of
+  // the nonzero regions are needed at the end.
+  auto* data = fft_data_.data();
+  for (auto i = iymin; i <= iymax; ++i)
+    gsl_fft_complex_radix2_forward(
+      data + 2*static_cast<std::size_t>(i)*n, 1, n);
+  for (std::size_t i = 0; i < n; ++i)
+    gsl_fft_complex_radix2_forward(data + 2*i, n, n);
+
+  for (std::size_t k = 0; k < n*n; ++k) {
+    data[2*k] *= fft_kernel_[k];
+    data[2*k + 1] *= fft_kernel_[k];
   }
+
+  for (std::size_t i = 0; i < n; ++i)
+    gsl_fft_complex_radix2_backward(data + 2*i, n, n);
+  for (auto i = rows.iymin; i <= rows.iymax; ++i)
+    gsl_fft_complex_radix2_backward(
+      data + 2*static_cast<std::size_t>(i + fft_pad_)*n, 1, n);
+
+  // Copy out the nonzero regions.  Round-off and the sinc compensation leave
+  // small negative ripples where the thickness vanishes; clip them since the
+  // generalized mean requires non-negative thickness.
+  auto copy = [this, n, data](const Region& r, Grid& TX, std::size_t part) {
+    for (auto iy = r.iymin; iy <= r.iymax; ++iy) {
+      const auto* row = data + part +
+        2*(static_cast<std::size_t>(iy + fft_pad_)*n +
+           static_cast<std::size_t>(fft_pad_));
+      for (auto ix = r.ixmin; ix <= r.ixmax; ++ix)
+        TX[iy][ix] = std::max(row[2*ix], 0.);
+    }
+  };
+  copy(region_A_, TA_, 0);
+  copy(region_B_, TB_, 1);
 }
 
 template <typename GenMean>
 void Event::compute_reduced_thickness(GenMean gen_mean) {
+  // Wipe the previous event, then determine where TR may be nonzero.
+  zero_cells(TR_, region_TR_.ixmin, region_TR_.ixmax,
+             region_TR_.iymin, region_TR_.iymax);
+  if (overlap_only_) {
+    region_TR_ = Region{
+      std::max(region_A_.ixmin, region_B_.ixmin),
+      std::min(region_A_.ixmax, region_B_.ixmax),
+      std::max(region_A_.iymin, region_B_.iymin),
+      std::min(region_A_.iymax, region_B_.iymax)
+    };
+  } else {
+    region_TR_ = region_A_;
+    if (!region_B_.empty())
+      region_TR_.cover(region_B_.ixmin, region_B_.ixmax,
+                       region_B_.iymin, region_B_.iymax);
+  }
+
   double sum = 0.;
   double ixcm = 0.;
   double iycm = 0.;
 
-  for (int iy = 0; iy < nsteps_; ++iy) {
-    for (int ix = 0; ix < nsteps_; ++ix) {
-      auto ta = TA_[iy][ix];
-      auto tb = TB_[iy][ix];
-      auto t = norm_ * gen_mean(ta, tb);
-      /// At midrapidity    
-      TR_[iy][ix][0] = t;
-      /// If operating in the 3D mode, the 3D density_ array is filled with
-      /// its value at eta=0 identical to TR_ array
-      if (is3D()) {
-        auto mean = mean_coeff_ * mean_function(ta, tb, exp_ybeam_);
-        auto std = std_coeff_ * std_function(ta, tb);
-        auto skew = skew_coeff_ * skew_function(ta, tb, skew_type_);
-        cgf_.calculate_dsdy(mean, std, skew);
-        auto mid_norm = cgf_.interp_dsdy(0.)*eta2y_.Jacobian(0.);
-        for (int ieta = 0; ieta < neta_; ++ieta) {
-          auto eta = -etamax_ + ieta*deta_;
-          auto rapidity = eta2y_.rapidity(eta);
-          auto jacobian = eta2y_.Jacobian(eta);
-          auto rapidity_dist = cgf_.interp_dsdy(rapidity);
-          density_[iy][ix][ieta] = t * rapidity_dist / mid_norm * jacobian;
-        }
+  tr_spans_.clear();
+  auto* cells = tr_cells_.data();
+  std::size_t offset = 0;
+
+  const auto region = region_TR_;
+  const auto norm = static_cast<GridElement>(norm_);
+  const auto tiny = static_cast<GridElement>(TINY);
+  for (int iy = region.iymin; iy <= region.iymax; ++iy) {
+    // Evaluate the row at midrapidity in a loop of its own, which the compiler
+    // can vectorize, then accumulate the sums (a reduction it cannot reorder).
+    // Local copies of the bounds and norm keep the stores from aliasing them.
+    const auto* ta = &TA_[iy][0];
+    const auto* tb = &TB_[iy][0];
+    auto* tr = &TR_[iy][0][0];
+    for (int ix = region.ixmin; ix <= region.ixmax; ++ix)
+      tr[ix] = norm * gen_mean(ta[ix], tb[ix]);
+
+    // Sum the row in independent lanes, so that the additions do not form one
+    // long dependency chain and the lanes vectorize.
+    double lane_sum[sum_lanes] = {}, lane_xsum[sum_lanes] = {};
+    auto ix = region.ixmin;
+    for (; ix + sum_lanes <= region.ixmax + 1; ix += sum_lanes) {
+      for (int j = 0; j < sum_lanes; ++j) {
+        auto t = static_cast<double>(tr[ix + j]);
+        lane_sum[j] += t;
+        lane_xsum[j] += t * static_cast<double>(ix + j);
       }
+    }
+    for (int j = 0; ix <= region.ixmax; ++ix, ++j) {
+      auto t = static_cast<double>(tr[ix]);
+      lane_sum[j] += t;
+      lane_xsum[j] += t * static_cast<double>(ix);
+    }
+    double row_sum = 0., row_xsum = 0.;
+    for (int j = 0; j < sum_lanes; ++j) {
+      row_sum += lane_sum[j];
+      row_xsum += lane_xsum[j];
+    }
+
+    sum += row_sum;
+    // Center of mass grid indices.
+    // No need to multiply by dxy since it would be canceled later.
+    ixcm += row_xsum;
+    iycm += row_sum * static_cast<double>(iy);
 
-      sum += t;
-      // Center of mass grid indices.
-      // No need to multiply by dxy since it would be canceled later.
-      ixcm += t * static_cast<double>(ix);
-      iycm += t * static_cast<double>(iy);
+    // While the row is in cache, trim the cells below TINY (which the
+    // observables ignore) from its ends and copy the rest to the compact cache
+    // of compute_observables(), which then reads neither TR_ nor its zeros.
+    auto first = region.ixmin, last = region.ixmax;
+    while (first <= last && tr[first] < tiny)
+      ++first;
+    while (last > first && tr[last] < tiny)
+      --last;
+    if (first <= last) {
+      const auto count = last - first + 1;
+      std::copy(tr + first, tr + last + 1, cells + offset);
+      tr_spans_.push_back(Span{iy, first, count, offset});
+      offset += static_cast<std::size_t>(count);
     }
   }
 
@@ -279,97 +842,312 @@ void Event::compute_reduced_thickness(GenMean gen_mean) {
   iycm_ = iycm / sum;
 }
 
+std::array<std::size_t, 3> Event::density_shape() const {
+  const auto n = static_cast<std::size_t>(nsteps_);
+  return {{n, n, is3D() ? static_cast<std::size_t>(neta_) : 1}};
+}
+
+void Event::compute_density() {
+  // Streamed densities are computed by for_each_density_row(), which also
+  // accumulates the eta-dependent observables, so that each row is computed
+  // once.  Hence there is nothing to do, unless the density is not output and
+  // the observables are needed.
+  const auto store = is3D() && !stream_density_ && !no_density_;
+  eta_pending_ = eta_observables_ && stream_density_ && !no_density_;
+  if (eta_pending_) {
+    // Until then, there are no observables of this event.
+    const auto nan = std::numeric_limits<double>::quiet_NaN();
+    std::fill(eta_multiplicity_.begin(), eta_multiplicity_.end(), nan);
+    std::fill(eta_ecc_vectors_.begin(), eta_ecc_vectors_.end(),
+              std::complex<double>{nan, nan});
+    std::fill(eta_eccentricity_.begin(), eta_eccentricity_.end(), nan);
+    std::fill(eta_psi_.begin(), eta_psi_.end(), nan);
+    std::fill(eta_decorrelation_.begin(), eta_decorrelation_.end(), nan);
+    return;
+  }
+  if (!store && !eta_observables_)
+    return;
+
+  if (store) {
+    // Wipe the previous event; the density vanishes outside the TR region.
+    zero_cells(density_, region_density_.ixmin, region_density_.ixmax,
+               region_density_.iymin, region_density_.iymax);
+    region_density_ = region_TR_;
+  }
+
+  if (eta_observables_)
+    std::fill(eta_sums_.begin(), eta_sums_.end(), 0.);
+
+  const auto& region = region_TR_;
+  for (int iy = region.iymin; iy <= region.iymax; ++iy) {
+    GridElement* row;
+    if (store) {
+      row = &density_[iy][0][0];
+    } else {
+      row = density_row_.data();
+      std::fill(density_row_.begin(), density_row_.end(), GridElement{0});
+    }
+    fill_density_row(iy, row);
+    if (eta_observables_)
+      accumulate_eta_moments(iy, row);
+  }
+
+  if (eta_observables_)
+    finish_eta_observables();
+}
+
+void Event::fill_density_row(int iy, GridElement* row) const {
+  const auto& region = region_TR_;
+  if (iy < region.iymin || iy > region.iymax)
+    return;
+
+  // The 3D density_ array is filled with its value at eta=0 identical to
+  // the TR_ array.
+  for (int ix = region.ixmin; ix <= region.ixmax; ++ix) {
+    auto t = TR_[iy][ix][0];
+    if (t == 0.)
+      // Nothing to distribute; the cell is already zero.
+      continue;
+    auto ta = TA_[iy][ix];
+    auto tb = TB_[iy][ix];
+    auto mean = mean_coeff_ * mean_function(ta, tb, exp_ybeam_);
+    auto std = std_coeff_ * std_function(ta, tb);
+    auto skew = skew_coeff_ * skew_function(ta, tb, skew_type_);
+    cgf_.calculate_dsdy(mean, std, skew);
+    // The rapidity and Jacobian at each eta slice are the same for all
+    // cells (see the plan in fast_eta2y); only the profile changes.
+    auto mid_norm = cgf_.interp_dsdy(0.)*mid_jacobian_;
+    cgf_.interp_dsdy(eta2y_.rapidity_plan().data(),
+                     static_cast<std::size_t>(neta_),
+                     eta2y_.Jacobian_plan().data(), t / mid_norm,
+                     row + ix*neta_);
+  }
+}
+
 void Event::compute_observables() {
   // Compute eccentricity at mid rapidity
 
-  // Simple helper class for use in the following loop.
-  struct EccentricityAccumulator {
-    double re = 0.;  // real part
-    double im = 0.;  // imaginary part
-    double wt = 0.;  // weight
-    double finish() const  // compute final eccentricity
-    { return std::sqrt(re*re + im*im) / std::fmax(wt, TINY); }
-    double angle() const  // compute event plane angle
-    { return atan2(im, re); }
-  } e2, e3, e4, e5;
-
-  for (int iy = 0; iy < nsteps_; ++iy) {
-    for (int ix = 0; ix < nsteps_; ++ix) {
-      const auto& t = TR_[iy][ix][0];
-      if (t < TINY)
-        continue;
+  // The eccentricity harmonics are weighted averages of r^m*exp(i*n*phi) over
+  // the entropy profile (reduced thickness), for all harmonics in one pass
+  // over the grid.  The naive way to compute exp(i*n*phi) at a given (x, y)
+  // point is essentially:
+  //
+  //   phi = arctan2(y, x)
+  //   real = cos(n*phi)
+  //   imag = sin(n*phi)
+  //
+  // However this requires trig functions for every n.  Instead, start from
+  // exp(i*phi) = (x + i*y)/r and obtain each next harmonic by one complex
+  // multiplication, exp(i*n*phi) = exp(i*(n-1)*phi) * exp(i*phi), which is the
+  // Chebyshev recurrence for cos(n*phi) and sin(n*phi).  Likewise the default
+  // weight r^n is updated by one multiplication per harmonic.
+  //
+  // Each row of the grid is processed in blocks of cells held in local arrays,
+  // and the moments are summed per position in the block, so that every loop
+  // over cells is elementwise and vectorizes; the sums are reduced at the end.
+  // The rows are read from the compact cache of their nonzero spans made by
+  // compute_reduced_thickness(), so this pass does not touch TR_ itself.
+  //
+  // The Event unit test verifies that the two methods agree.
+  const auto xcm = ixcm_, ycm = iycm_;
+  const auto nharmonics = harmonics_.size();
+  const auto nmax = harmonics_.back();
+  const auto m = radial_weight_;
+
+  // Sums of the real part, imaginary part and weight of each harmonic.
+  auto* sums = moment_sums_.data();
+  std::fill(moment_sums_.begin(), moment_sums_.end(), 0.);
+
+  double base_re[moment_block], base_im[moment_block];
+  double re[moment_block], im[moment_block];
+  double weight[moment_block], step[moment_block];
+
+  for (const auto& span : tr_spans_) {
+    const auto y = static_cast<double>(span.iy) - ycm;
+    for (int i0 = 0; i0 < span.count; i0 += moment_block) {
+      const auto* tr = tr_cells_.data() + span.offset + i0;
+      const auto ixmin = span.ixmin + i0;
+      const auto len = std::min(span.count - i0, moment_block);
 
-      // Compute (x, y) relative to the CM and cache powers of x, y, r.
-      auto x = static_cast<double>(ix) - ixcm_;
-      auto x2 = x*x;
-      auto x3 = x2*x;
-      auto x4 = x2*x2;
-
-      auto y = static_cast<double>(iy) - iycm_;
-      auto y2 = y*y;
-      auto y3 = y2*y;
-      auto y4 = y2*y2;
-
-      auto r2 = x2 + y2;
-      auto r = std::sqrt(r2);
-      auto r4 = r2*r2;
-
-      auto xy = x*y;
-      auto x2y2 = x2*y2;
-
-      // The eccentricity harmonics are weighted averages of r^n*exp(i*n*phi)
-      // over the entropy profile (reduced thickness).  The naive way to compute
-      // exp(i*n*phi) at a given (x, y) point is essentially:
-      //
-      //   phi = arctan2(y, x)
-      //   real = cos(n*phi)
-      //   imag = sin(n*phi)
-      //
-      // However this implementation uses three unnecessary trig functions; a
-      // much faster method is to express the cos and sin directly in terms of x
-      // and y.  For example, it is trivial to show (by drawing a triangle and
-      // using rudimentary trig) that
-      //
-      //   cos(arctan2(y, x)) = x/r = x/sqrt(x^2 + y^2)
-      //   sin(arctan2(y, x)) = y/r = x/sqrt(x^2 + y^2)
-      //
-      // This is easily generalized to cos and sin of (n*phi) by invoking the
-      // multiple angle formula, e.g. sin(2x) = 2sin(x)cos(x), and hence
-      //
-      //   sin(2*arctan2(y, x)) = 2*sin(arctan2(y, x))*cos(arctan2(y, x))
-      //                        = 2*x*y / r^2
-      //
-      // Which not only eliminates the trig functions, but also naturally
-      // cancels the r^2 weight.  This cancellation occurs for all n.
-      //
-      // The Event unit test verifies that the two methods agree.
-      e2.re += t * (x2 - y2);
-      e2.im += t * 2.*xy;
-      e2.wt += t * r2;
-
-      e3.re += t * (x3 - 3.*x*y2);
-      e3.im += t * y*(3. - 4.*y2);
-      e3.wt += t * r2*r;
-
-      e4.re += t * (x4 + y4 - 6.*x2y2);
-      e4.im += t * 4.*xy*(1. - 2.*y2);
-      e4.wt += t * r4;
-
-      e5.re += t * x*(x4 - 10.*x2y2 - 5.*y4);
-      e5.im += t * y*(1. - 12.*x2 + 16.*x4);
-      e5.wt += t * r4*r;
+      // (x, y) relative to the CM, and the factors by which the moment
+      // (re, im) and the weight advance per harmonic, starting at n = 1.
+      // Cells below TINY get zero weight.
+      if (m < 0) {
+        // For the weight r^n, the moment is t*r^n*exp(i*n*phi) = t*z^n with
+        // z = x + i*y, so it advances by z and the weight by r.  The CM cell
+        // (z = 0) contributes nothing.
+        for (int i = 0; i < len; ++i) {
+          auto x = static_cast<double>(ixmin + i) - xcm;
+          auto t = static_cast<double>(tr[i]);
+          t *= (t >= TINY);
+          base_re[i] = x;
+          base_im[i] = y;
+          re[i] = t*x;
+          im[i] = t*y;
+          step[i] = std::sqrt(x*x + y*y);
+          weight[i] = t*step[i];
+        }
+      } else {
+        // For a fixed weight r^m, the moment advances by exp(i*phi) = z/r and
+        // the weight stays.  phi is undefined at the CM cell, so it gets
+        // exp(i*phi) = 0.
+        for (int i = 0; i < len; ++i) {
+          auto x = static_cast<double>(ixmin + i) - xcm;
+          auto r = std::sqrt(x*x + y*y);
+          auto inv_r = (r > 0.)/std::max(r, TINY);
+          auto t = static_cast<double>(tr[i]);
+          base_re[i] = x*inv_r;
+          base_im[i] = y*inv_r;
+          step[i] = r;
+          weight[i] = (t >= TINY)*t;
+        }
+        for (int j = 0; j < m; ++j)
+          for (int i = 0; i < len; ++i)
+            weight[i] *= step[i];
+        for (int i = 0; i < len; ++i) {
+          re[i] = weight[i]*base_re[i];
+          im[i] = weight[i]*base_im[i];
+          step[i] = 1.;
+        }
+      }
+
+      std::size_t k = 0;
+      for (int n = 1; n <= nmax; ++n) {
+        if (n == harmonics_[k]) {
+          auto* sum_re = sums + 3*k*moment_block;
+          auto* sum_im = sum_re + moment_block;
+          auto* sum_wt = sum_im + moment_block;
+          for (int i = 0; i < len; ++i) {
+            sum_re[i] += re[i];
+            sum_im[i] += im[i];
+            sum_wt[i] += weight[i];
+          }
+          ++k;
+        }
+        if (n == nmax)
+          break;
+        for (int i = 0; i < len; ++i) {
+          auto next_re = re[i]*base_re[i] - im[i]*base_im[i];
+          im[i] = re[i]*base_im[i] + im[i]*base_re[i];
+          re[i] = next_re;
+          weight[i] *= step[i];
+        }
+      }
     }
   }
 
-  eccentricity_[2] = e2.finish();
-  eccentricity_[3] = e3.finish();
-  eccentricity_[4] = e4.finish();
-  eccentricity_[5] = e5.finish();
+  for (std::size_t k = 0; k < nharmonics; ++k) {
+    const auto* sum = sums + 3*k*moment_block;
+    double re_total = 0., im_total = 0., wt_total = 0.;
+    for (int i = 0; i < moment_block; ++i) {
+      re_total += sum[i];
+      im_total += sum[moment_block + i];
+      wt_total += sum[2*moment_block + i];
+    }
+    ecc_vectors_[k] = std::complex<double>{re_total, im_total} /
+                      std::fmax(wt_total, TINY);
+    eccentricity_[k] = std::abs(ecc_vectors_[k]);
+    psi_[k] = std::arg(ecc_vectors_[k])/harmonics_[k];
+  }
+}
 
-  psi_[2] = e2.angle()/2.;
-  psi_[3] = e3.angle()/3.;
-  psi_[4] = e4.angle()/4.;
-  psi_[5] = e5.angle()/5.;
+void Event::accumulate_eta_moments(int iy, const GridElement* row) const {
+  // Same moments as compute_observables(), but weighted by the density of each
+  // slice instead of TR.  The harmonic factors r^m*exp(i*n*phi) of a cell do
+  // not depend on eta, so they are computed once per cell, and the loops over
+  // the contiguous slices of the cell vectorize.
+  const auto neta = static_cast<std::size_t>(neta_);
+  const auto nharmonics = harmonics_.size();
+  const auto nmax = harmonics_.back();
+  const auto m = radial_weight_;
+  const auto y = static_cast<double>(iy) - iycm_;
+
+  auto* factors = eta_factors_.data();
+  auto* mult = eta_sums_.data();
+  auto* sums = mult + neta;
+
+  const auto& region = region_TR_;
+  for (int ix = region.ixmin; ix <= region.ixmax; ++ix) {
+    // The density vanishes where TR does.
+    if (TR_[iy][ix][0] < TINY)
+      continue;
+    const auto* d = row + static_cast<std::size_t>(ix)*neta;
+
+    auto x = static_cast<double>(ix) - ixcm_;
+    auto r = std::sqrt(x*x + y*y);
+    auto inv_r = (r > 0.)/std::max(r, TINY);
+    auto base = std::complex<double>{x*inv_r, y*inv_r};
+    auto harmonic = base;
+    auto weight = (m < 0) ? r : std::pow(r, m);
+    auto step = (m < 0) ? r : 1.;
+
+    std::size_t k = 0;
+    for (int n = 1; n <= nmax && k < nharmonics; ++n) {
+      if (n == harmonics_[k]) {
+        factors[3*k] = weight*harmonic.real();
+        factors[3*k + 1] = weight*harmonic.imag();
+        factors[3*k + 2] = weight;
+        ++k;
+      }
+      harmonic *= base;
+      weight *= step;
+    }
+
+    for (std::size_t ieta = 0; ieta < neta; ++ieta)
+      mult[ieta] += d[ieta];
+
+    for (k = 0; k < nharmonics; ++k) {
+      const auto f_re = factors[3*k], f_im = factors[3*k + 1],
+                 f_wt = factors[3*k + 2];
+      auto* sum_re = sums + 3*k*neta;
+      auto* sum_im = sum_re + neta;
+      auto* sum_wt = sum_im + neta;
+      for (std::size_t ieta = 0; ieta < neta; ++ieta) {
+        const auto dk = static_cast<double>(d[ieta]);
+        sum_re[ieta] += f_re*dk;
+        sum_im[ieta] += f_im*dk;
+        sum_wt[ieta] += f_wt*dk;
+      }
+    }
+  }
+}
+
+void Event::finish_eta_observables() const {
+  const auto neta = static_cast<std::size_t>(neta_);
+  const auto steps = 2.*etamax_/deta_;
+  const auto symmetric = std::fabs(steps - std::round(steps)) < 1e-6 &&
+                         std::lround(steps) == neta_ - 1;
+  const auto* mult = eta_sums_.data();
+  const auto* sums = mult + neta;
+
+  for (std::size_t ieta = 0; ieta < neta; ++ieta)
+    eta_multiplicity_[ieta] = dxy_ * dxy_ * mult[ieta];
+
+  for (std::size_t k = 0; k < harmonics_.size(); ++k) {
+    const auto* sum_re = sums + 3*k*neta;
+    const auto* sum_im = sum_re + neta;
+    const auto* sum_wt = sum_im + neta;
+    auto* ecc = &eta_ecc_vectors_[k*neta];
+    for (std::size_t ieta = 0; ieta < neta; ++ieta) {
+      ecc[ieta] = std::complex<double>{sum_re[ieta], sum_im[ieta]} /
+                  std::fmax(sum_wt[ieta], TINY);
+      eta_eccentricity_[k*neta + ieta] = std::abs(ecc[ieta]);
+      eta_psi_[k*neta + ieta] = std::arg(ecc[ieta])/harmonics_[k];
+    }
+
+    // Slice i is at eta = -etamax + i*deta, so its mirror at -eta is
+    // 2*etamax/deta - i = neta - 1 - i, if that is an integer.
+    for (std::size_t ieta = 0; ieta < neta; ++ieta) {
+      auto& r = eta_decorrelation_[k*neta + ieta];
+      if (!symmetric) {
+        r = std::numeric_limits<double>::quiet_NaN();
+        continue;
+      }
+      auto mirror = neta - 1 - ieta;
+      auto product = ecc[ieta]*std::conj(ecc[mirror]);
+      r = product.real()/std::fmax(std::abs(product), TINY);
+    }
+  }
 }
 
 }  // namespace trento
@@ -6,8 +6,13 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include <algorithm>
+#include <array>
+#include <complex>
 #include <functional>
-#include <map>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 #ifdef NDEBUG
 #define BOOST_DISABLE_ASSERTS
@@ -37,7 +42,7 @@ class NucleonProfile;
 ///       event.npart(),
 ///       event.multiplicity(),
 ///       event.eccentricity(),
-///       event.reduced_thickness_grid()
+///       event.density_grid()
 ///     );
 ///   }
 ///
@@ -56,11 +61,48 @@ class Event {
   void compute(const Nucleus& nucleusA, const Nucleus& nucleusB,
                NucleonProfile& profile);
 
+  /// \rst
+  /// The stages of ``compute()``, in order.  Each stage requires the previous
+  /// ones, and makes the listed properties available, so callers applying
+  /// cuts can reject an event at the earliest stage that decides it:
+  ///
+  /// 1. ``compute_npart()``: ``npart()``
+  /// 2. ``compute_thickness()``: the TA and TB grids
+  /// 3. ``compute_midrapidity()``: ``multiplicity()`` and the reduced
+  ///    thickness at midrapidity
+  /// 4. ``compute_observables()``: ``eccentricity()`` and ``event_planes()``
+  /// 5. ``compute_density()``: the 3D density grid and, if enabled, the
+  ///    eta-dependent observables (only in 3D mode)
+  ///
+  /// With ``--ncoll`` or ``--collision-vertices``, ``compute_collisions()``
+  /// builds the TAB grid and the vertex table, respectively, from the binary
+  /// collisions recorded by ``add_collision()``.  It depends only on the
+  /// nuclei, so it may run at any point after them, e.g. once the event has
+  /// passed all cuts.
+  /// \endrst
+  void compute_npart(const Nucleus& nucleusA, const Nucleus& nucleusB);
+  void compute_thickness(const Nucleus& nucleusA, const Nucleus& nucleusB,
+                         NucleonProfile& profile);
+  void compute_midrapidity();
+  void compute_collisions(const Nucleus& nucleusA, const Nucleus& nucleusB,
+                          const NucleonProfile& profile);
+  void compute_observables();
+  void compute_density();
+
+  /// Grid element type: single precision if built with the FLOAT32 CMake
+  /// option, otherwise double.  Integrals over the grids (multiplicity,
+  /// eccentricity) are accumulated in double either way.
+#ifdef TRENTO_FLOAT32
+  using GridElement = float;
+#else
+  using GridElement = double;
+#endif
+
   /// Alias for a 2-dimensional grid
-  using Grid = boost::multi_array<double, 2>;
+  using Grid = boost::multi_array<GridElement, 2>;
 
   /// Alias for a 3-dimensional grid
-  using Grid3D = boost::multi_array<double, 3>;
+  using Grid3D = boost::multi_array<GridElement, 3>;
 
   /// Number of nucleon participants.
   const int& npart() const
@@ -78,16 +120,39 @@ class Event {
   { return multiplicity_; }
 
   /// \rst
-  /// Eccentricity harmonics `\varepsilon_n` for *n* = 2--5.
-  /// Returns a map of `(n : \varepsilon_n)` pairs, so e.g.::
+  /// Harmonic orders *n* of the eccentricities and event planes, in increasing
+  /// order (option ``--harmonics``, by default 2--5).  The observables below
+  /// are flat arrays aligned with this one, so e.g.::
   ///
-  ///   double e2 = event.eccentricity().at(2);
+  ///   for (std::size_t k = 0; k < event.harmonics().size(); ++k)
+  ///     use(event.harmonics()[k], event.eccentricity()[k]);
   ///
   /// \endrst
-  const std::map<int, double>& eccentricity() const
+  const std::vector<int>& harmonics() const
+  { return harmonics_; }
+
+  /// \rst
+  /// Complex eccentricity harmonics
+  ///
+  /// .. math::
+  ///
+  ///   \mathcal E_n = \frac{\int r^m e^{in\phi} s \, dx \, dy}
+  ///                        {\int r^m s \, dx \, dy}
+  ///
+  /// about the center of mass of the reduced thickness *s*.  The radial
+  /// weight is `r^n` unless a fixed power *m* is set (option
+  /// ``--radial-weight``).
+  /// \endrst
+  const std::vector<std::complex<double>>& eccentricity_vectors() const
+  { return ecc_vectors_; }
+
+  /// Eccentricity harmonics, the magnitudes of eccentricity_vectors().
+  const std::vector<double>& eccentricity() const
   { return eccentricity_; }
 
-  /// The entropy (particle) density grid as a three-dimensional array.
+  /// The entropy (particle) density grid as a three-dimensional array.  Empty
+  /// if the density is streamed (see for_each_density_row()) or not output
+  /// (option ``--no-density``).
   const Grid3D& density_grid() const {
     if (is3D())
       return density_;
@@ -95,6 +160,79 @@ class Event {
 	  return TR_;
   }
 
+  /// Shape (ny, nx, neta) of the density grid, also when it is streamed.
+  std::array<std::size_t, 3> density_shape() const;
+
+  /// \rst
+  /// Call ``f(iy, row)`` for each row of the density grid in order, where
+  /// ``row`` points to the ``nx*neta`` values of the cells ``(iy, 0..nx-1)`` in
+  /// the layout of ``density_grid()``.  Writers should use this rather than
+  /// ``density_grid()``: if the density is streamed (option
+  /// ``--stream-density``), the 3D extension computes each row on demand into
+  /// a buffer, so memory scales with one row instead of the whole volume, and
+  /// the first visit after ``compute()`` also computes the eta-dependent
+  /// observables.  The buffer is shared, so ``f`` must not visit the rows
+  /// again (std::logic_error).
+  /// Visits no rows if the density is not output (option ``--no-density``).
+  /// \endrst
+  template <typename F>
+  void for_each_density_row(F&& f) const;
+
+  /// Whether the 3D density is streamed rather than stored.
+  bool streams_density() const
+  { return stream_density_; }
+
+  /// Whether the density is output at all (not so with ``--no-density``).
+  bool has_density() const
+  { return !no_density_; }
+
+  /// \rst
+  /// Whether the eta-dependent observables below are computed (option
+  /// ``--eta-observables``, only in 3D mode).  They are computed from the 3D
+  /// density by ``compute_density()``, in slices at the pseudorapidities
+  /// ``-etamax + i*deta`` of the density grid, i.e. along its last index.  A
+  /// streamed density is only computed by ``for_each_density_row()``, so they
+  /// are accumulated from its rows as they are written, and are NaN until the
+  /// first visit has finished.
+  ///
+  /// The harmonics are those of ``harmonics()`` with the same radial weight,
+  /// about the center of mass of the midrapidity reduced thickness in all
+  /// slices, so that the slices share a frame.  The arrays are flat with the
+  /// slice index fastest, e.g. ``eta_eccentricity()[k*neta + i]`` is the
+  /// eccentricity of harmonic ``harmonics()[k]`` in slice *i*.
+  /// \endrst
+  bool has_eta_observables() const
+  { return eta_observables_; }
+
+  /// Entropy per unit pseudorapidity `dS/d\eta` of each slice.
+  const std::vector<double>& eta_multiplicity() const
+  { return eta_multiplicity_; }
+
+  /// Complex eccentricities of each harmonic and slice.
+  const std::vector<std::complex<double>>& eta_eccentricity_vectors() const
+  { return eta_ecc_vectors_; }
+
+  /// Eccentricities of each harmonic and slice.
+  const std::vector<double>& eta_eccentricity() const
+  { return eta_eccentricity_; }
+
+  /// Event plane angles of each harmonic and slice.
+  const std::vector<double>& eta_event_planes() const
+  { return eta_psi_; }
+
+  /// \rst
+  /// Forward-backward event plane decorrelation of each harmonic and slice,
+  ///
+  /// .. math::
+  ///
+  ///   r_n(\eta) = \cos n[\Psi_n(\eta) - \Psi_n(-\eta)],
+  ///
+  /// which is one for aligned planes.  NaN if the slices are not symmetric
+  /// about `\eta = 0`, i.e. if the step does not evenly divide the eta range.
+  /// \endrst
+  const std::vector<double>& eta_decorrelation() const
+  { return eta_decorrelation_; }
+
   /// returns grid steps
   const double& dxy() const
   { return dxy_; }
@@ -102,7 +240,12 @@ class Event {
   const double& deta() const
   { return deta_; }
 
-  const std::map<int, double>& event_planes() const
+  /// Pseudorapidity of the first slice of the 3D grid is -etamax().
+  const double& etamax() const
+  { return etamax_; }
+
+  /// Event plane angles, the arguments of eccentricity_vectors() divided by n.
+  const std::vector<double>& event_planes() const
   { return psi_; }
 
 
@@ -110,23 +253,132 @@ class Event {
   const Grid& TAB_grid() const
   { return TAB_; }
 
-  /// WK: clear and increase TAB
-  void clear_TAB(void);
-  void accumulate_TAB(Nucleon& A, Nucleon& B, NucleonProfile& profile);
+  /// Whether the TAB grid is computed (option ``--ncoll``).
+  const bool& has_ncoll_density() const
+  { return with_ncoll_density_; }
+
+  /// \rst
+  /// Whether the binary collision vertices are computed (option
+  /// ``--collision-vertices``), and the vertices: for each collision, the
+  /// midpoint *x*, *y* [fm] of the nucleon pair and its impact parameter *b*
+  /// [fm], back to back, i.e. ``3*ncoll()`` values.
+  /// \endrst
+  const bool& has_collision_vertices() const
+  { return with_vertices_; }
+  const std::vector<double>& collision_vertices() const
+  { return vertices_; }
+
+  /// \rst
+  /// Record the binary collisions of an event: ``clear_collisions()`` starts
+  /// a new event, and ``add_collision()`` adds the collision of nucleon *iA*
+  /// of nucleus A with nucleon *iB* of nucleus B and increments ``ncoll()``.
+  /// Only the indices are stored; ``compute_collisions()`` turns them into
+  /// the TAB grid and vertices, so events rejected before then do not pay for
+  /// it.
+  /// \endrst
+  void clear_collisions()
+  { ncoll_ = 0; collisions_.clear(); }
+  void add_collision(std::size_t iA, std::size_t iB)
+  { ++ncoll_; collisions_.emplace_back(iA, iB); }
 
-  /// WK:
+  /// WK: Whether the binary collisions are recorded (either of ``--ncoll``
+  /// and ``--collision-vertices``).
   const bool& with_ncoll() const
   { return with_ncoll_; }
 
  private:
+  /// A rectangle of grid cells [ixmin, ixmax] x [iymin, iymax], used to track
+  /// where a grid may be nonzero.  Cells outside are exactly zero, so the
+  /// passes over a grid only visit its region, and wiping a grid only clears
+  /// the region of the previous event.
+  struct Region {
+    int ixmin, ixmax, iymin, iymax;
+
+    /// Empty by default.
+    Region() : Region(0, -1, 0, -1) {}
+    Region(int xmin, int xmax, int ymin, int ymax)
+        : ixmin(xmin), ixmax(xmax), iymin(ymin), iymax(ymax) {}
+
+    bool empty() const
+    { return ixmin > ixmax || iymin > iymax; }
+
+    /// Extend to cover the given rectangle.
+    void cover(int xmin, int xmax, int ymin, int ymax) {
+      if (empty()) {
+        *this = Region{xmin, xmax, ymin, ymax};
+        return;
+      }
+      ixmin = std::min(ixmin, xmin);
+      ixmax = std::max(ixmax, xmax);
+      iymin = std::min(iymin, ymin);
+      iymax = std::max(iymax, ymax);
+    }
+  };
+
   /// Compute a nuclear thickness function (TA or TB) onto a grid for a given
-  /// nucleus and nucleon profile.  This destroys any data previously contained
-  /// by the grid.
+  /// nucleus and nucleon profile, and set its nonzero region.  This destroys
+  /// any data previously contained by the grid.  Template parameter Deposit
+  /// adds a single participant to its subgrid; it is determined at runtime
+  /// based on the configuration.
+  template <typename Deposit>
   void compute_nuclear_thickness(
-      const Nucleus& nucleus, NucleonProfile& profile, Grid& TX);
+      const Nucleus& nucleus, NucleonProfile& profile, Grid& TX,
+      Region& region, Deposit deposit);
+
+  /// Compute both TA and TB, either by compute_nuclear_thickness<Deposit>
+  /// with a bound deposition kernel or by the FFT engine.  Created in the ctor
+  /// like compute_reduced_thickness_.
+  std::function<void(const Nucleus&, const Nucleus&, NucleonProfile&)>
+    compute_thickness_grids_;
+
+  /// Deposition kernels: add the thickness of a participant at grid
+  /// coordinates (x, y) to the cells [ixmin, ixmax] x [iymin, iymax] of TX.
+  /// The direct kernel evaluates the profile at every cell; the separable
+  /// kernel factorizes the Gaussian into two 1D vectors and adds their outer
+  /// product row by row, restricted to the truncation circle.  The stamp
+  /// kernel does the same with the nearest-phase stamps precomputed by the
+  /// NucleonProfile instead of evaluating exponentials.
+  void deposit_direct(double x, double y,
+                      int ixmin, int ixmax, int iymin, int iymax,
+                      const NucleonProfile& profile, Grid& TX) const;
+  void deposit_separable(double x, double y,
+                         int ixmin, int ixmax, int iymin, int iymax,
+                         const NucleonProfile& profile, Grid& TX);
+  void deposit_stamp(double x, double y,
+                     int ixmin, int ixmax, int iymin, int iymax,
+                     const NucleonProfile& profile, Grid& TX) const;
 
-  /// Compute the reduced thickness function (TR) after computing TA and TB.
-  /// Template parameter GenMean sets the actual function that returns TR(TA, TB).
+  /// \rst
+  /// Convolution engine: splat the participants of both nuclei bilinearly
+  /// onto a zero-padded grid, with their fluctuated prefactors as weights, then
+  /// convolve once with the Gaussian profile by FFT.  TA and TB are
+  /// transformed together as the real and imaginary parts of one complex grid,
+  /// which works because the kernel is real and symmetric.  The cost is
+  /// independent of the number of participants.
+  ///
+  /// The kernel is the analytic transform of the Gaussian divided by the
+  /// transform of the bilinear (tent) splat, `\mathrm{sinc}^2(q\Delta/2)` per
+  /// axis, which removes the leading smoothing error of the splat.  Unlike the
+  /// other kernels the profile is not truncated, a relative difference of
+  /// `e^{-12.5} \approx 4\times10^{-6}` at the truncation radius.
+  /// \endrst
+  void compute_thickness_grids_fft(const Nucleus& nucleusA,
+                                   const Nucleus& nucleusB,
+                                   NucleonProfile& profile);
+
+  /// Determine the padded FFT grid size and tabulate the kernel for the given
+  /// nucleon width.
+  void init_fft(double nucleon_width);
+
+  /// Add the 3D density of the cells (iy, ix) in the TR region to row, which
+  /// must initially be zero (cells with TR = 0 are skipped).  Const (with
+  /// mutable rapidity scratch) so that writers can stream the density.
+  void fill_density_row(int iy, GridElement* row) const;
+
+  /// Compute the reduced thickness function (TR) after computing TA and TB,
+  /// over the union of their regions, or the intersection if the generalized
+  /// mean vanishes when either argument does (p <= 0).  Template parameter
+  /// GenMean sets the actual function that returns TR(TA, TB).
   /// It is determined at runtime based on the configuration.
   template <typename GenMean>
   void compute_reduced_thickness(GenMean gen_mean);
@@ -137,9 +389,6 @@ class Event {
   /// single "virtual" function call per event.
   std::function<void()> compute_reduced_thickness_;
 
-  /// Compute observables that require a second pass over the reduced thickness grid.
-  void compute_observables();
-
   // Returns true if running in 3D mode, false otherwise.
   bool is3D() const;
 
@@ -165,8 +414,8 @@ class Event {
   /// fast eta to y transformer.
   fast_eta2y eta2y_;
 
-  /// cumulant generating approach
-  cumulant_generating cgf_;
+  /// cumulant generating approach; scratch of fill_density_row().
+  mutable cumulant_generating cgf_;
 
   /// Reduced thickness and entropy (particle) density grids
   Grid3D TR_, density_;
@@ -174,9 +423,43 @@ class Event {
   /// Nuclear thickness grids TA, TB and reduced thickness grid TR.
   Grid TA_, TB_, TAB_;
 
+  /// Nonzero regions of TA, TB, TR, the 3D density and TAB.  The density region
+  /// is tracked separately since compute_density() may not run for every TR.
+  Region region_A_, region_B_, region_TR_, region_density_, region_TAB_;
+
+  /// Index pairs (A, B) of the colliding nucleons of the current event.
+  std::vector<std::pair<std::size_t, std::size_t>> collisions_;
+
+  /// Add the binary collision density of one collision at grid coordinates
+  /// (x, y), the midpoint of the pair, to TAB.
+  void deposit_binary_collision(double x, double y,
+                                const NucleonProfile& profile);
+
+  /// Whether TR vanishes outside the overlap of TA and TB, i.e. p <= 0.
+  const bool overlap_only_;
+
   /// Center of mass coordinates in "units" of grid index (not fm).
   double ixcm_, iycm_;
 
+  /// Scratch space of the separable kernel: squared distances and Gaussian
+  /// factors along x and y.
+  std::vector<double> dxsq_, dysq_;
+  std::vector<GridElement> gauss_x_, gauss_y_;
+
+  /// FFT engine: padding on each side and total size (a power of two) of the
+  /// padded grid, the kernel in Fourier space, and the complex work grid.
+  int fft_pad_, fft_size_;
+  std::vector<double> fft_kernel_, fft_data_;
+
+  /// Jacobian at midrapidity, which normalizes the rapidity profiles.
+  const double mid_jacobian_;
+
+  /// Whether the 3D density is streamed, whether it is not output at all, and
+  /// the buffer of one row if it is not stored.
+  const bool stream_density_;
+  const bool no_density_;
+  mutable std::vector<GridElement> density_row_;
+
   /// Number of participants.
   int npart_;
 
@@ -186,16 +469,105 @@ class Event {
   /// Multiplicity (total entropy).
   double multiplicity_;
 
-  /// Eccentricity harmonics.
-  std::map<int, double> eccentricity_;
+  /// Harmonic orders, and the power of the radial weight (negative: n).
+  std::vector<int> harmonics_;
+  const int radial_weight_;
 
-  /// WK: Initial density event planes.
-  std::map<int, double> psi_;
+  /// Complex eccentricities, their magnitudes, and event planes.
+  std::vector<std::complex<double>> ecc_vectors_;
+  std::vector<double> eccentricity_;
 
-  /// WK:
+  /// WK: Initial density event planes.
+  std::vector<double> psi_;
+
+  /// Scratch space of compute_observables(): sums of the moments of each
+  /// harmonic per position in a block of cells.
+  std::vector<double> moment_sums_;
+
+  /// Compact cache of TR for compute_observables(), made by
+  /// compute_reduced_thickness(): the span of cells from the first to the last
+  /// above TINY of each row, with the values of all spans back to back.
+  struct Span {
+    int iy, ixmin, count;
+    std::size_t offset;
+  };
+  std::vector<GridElement> tr_cells_;
+  std::vector<Span> tr_spans_;
+
+  /// Accumulate the eta-dependent moments of a row of the 3D density, and
+  /// compute the observables from them.  Called while a streamed density is
+  /// visited, hence const.
+  void accumulate_eta_moments(int iy, const GridElement* row) const;
+  void finish_eta_observables() const;
+
+  /// Whether to compute the eta-dependent observables, whether they are
+  /// pending on the next visit of the streamed density, and whether it is
+  /// being visited.
+  const bool eta_observables_;
+  mutable bool eta_pending_, visiting_rows_;
+
+  /// Eta-dependent observables, the sums of their moments (real part,
+  /// imaginary part and weight of each harmonic, each slice fastest), and the
+  /// per-cell harmonic factors of accumulate_eta_moments().
+  mutable std::vector<double> eta_multiplicity_;
+  mutable std::vector<std::complex<double>> eta_ecc_vectors_;
+  mutable std::vector<double> eta_eccentricity_, eta_psi_, eta_decorrelation_;
+  mutable std::vector<double> eta_sums_, eta_factors_;
+
+  /// WK: Whether to record binary collisions, and which outputs to make.
   bool with_ncoll_;
+  const bool with_ncoll_density_, with_vertices_;
+
+  /// Binary collision vertices (x, y, b).
+  std::vector<double> vertices_;
 };
 
+template <typename F>
+void Event::for_each_density_row(F&& f) const {
+  if (no_density_)
+    return;
+
+  const auto shape = density_shape();
+  const auto row_size = shape[1]*shape[2];
+
+  if (!stream_density_) {
+    const auto* data = density_grid().origin();
+    for (int iy = 0; iy < nsteps_; ++iy)
+      f(iy, static_cast<const GridElement*>(
+        data + static_cast<std::size_t>(iy)*row_size));
+    return;
+  }
+
+  // The rows share one buffer, so they cannot be visited from within f.
+  if (visiting_rows_)
+    throw std::logic_error{"nested visit of a streamed density"};
+  struct VisitGuard {
+    bool& visiting;
+    ~VisitGuard() { visiting = false; }
+  } guard{visiting_rows_};
+  visiting_rows_ = true;
+
+  // Accumulate the pending eta-dependent observables from the same rows, in
+  // the order of compute_density().  Only this visit does, so if f throws,
+  // they stay NaN.
+  const auto accumulate = eta_pending_;
+  eta_pending_ = false;
+  if (accumulate)
+    std::fill(eta_sums_.begin(), eta_sums_.end(), 0.);
+
+  auto* row = density_row_.data();
+  for (int iy = 0; iy < nsteps_; ++iy) {
+    std::fill_n(row, row_size, GridElement{0});
+    fill_density_row(iy, row);
+    if (accumulate && iy >= region_TR_.iymin && iy <= region_TR_.iymax)
+      accumulate_eta_moments(iy, row);
+    f(iy, static_cast<const GridElement*>(row));
+  }
+
+  if (accumulate)
+    finish_eta_observables();
+}
+
 }  // namespace trento
 
 #endif  // EVENT_H
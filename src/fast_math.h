@@ -0,0 +1,133 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace trento {
+
+/// \rst
+/// Branch-free replacements for ``std::exp``, ``std::log`` and ``std::pow``,
+/// accurate to a few ulp.  Unlike the library functions they neither set
+/// ``errno`` nor branch on the argument, so loops calling them can be
+/// auto-vectorized.  They use the fdlibm polynomials with the reduction done by
+/// integer operations on the bit patterns, which vectorize with 64-bit integer
+/// lanes (e.g. AVX2).
+///
+/// Arguments are restricted to the ranges the callers need: ``fast_exp``
+/// clamps its finite argument to [-708, 709] (the range of normal results),
+/// and ``fast_log`` and ``fast_pow`` require a positive, normal argument.  For
+/// other non-negative arguments they still return finite values (e.g.
+/// ``fast_log(0) = -1023 ln 2``), so callers may mask the results instead of
+/// branching.
+///
+/// Example::
+///
+///   for (std::size_t i = 0; i < n; ++i)
+///     out[i] = fast_pow(in[i], p);  // vectorized
+///
+/// \endrst
+inline double fast_exp(double x);
+inline double fast_log(double x);
+inline double fast_pow(double x, double p);
+
+namespace fast_math_detail {
+
+inline std::uint64_t as_bits(double x) {
+  std::uint64_t u;
+  std::memcpy(&u, &x, sizeof u);
+  return u;
+}
+
+inline double from_bits(std::uint64_t u) {
+  double x;
+  std::memcpy(&x, &u, sizeof x);
+  return x;
+}
+
+// ln(2) split so that k*ln2_hi is exact for |k| < 2^11.
+constexpr double ln2_hi = 6.93147180369123816490e-01;
+constexpr double ln2_lo = 1.90821492927058770002e-10;
+
+// 1.5 * 2^52: adding this rounds a double of magnitude < 2^51 to an integer,
+// which is then held in the low mantissa bits.
+constexpr double round_shift = 6755399441055744.;
+
+// 2^52, whose mantissa holds small non-negative integers exactly.
+constexpr double two52 = 4503599627370496.;
+
+}  // namespace fast_math_detail
+
+inline double fast_exp(double x) {
+  using namespace fast_math_detail;
+
+  // Clamp by arithmetic rather than a conditional, which some compilers turn
+  // into a branch to a constant result and then fail to vectorize.
+  x += (x < -708.)*(-708. - x);
+  x += (x > 709.)*(709. - x);
+
+  // x = k*ln(2) + r, |r| <= ln(2)/2
+  auto kd = x*1.44269504088896338700 + round_shift;
+  auto k = as_bits(kd);
+  kd -= round_shift;
+  auto hi = x - kd*ln2_hi;
+  auto lo = kd*ln2_lo;
+  auto r = hi - lo;
+
+  // exp(r) by the fdlibm rational approximation.
+  auto t = r*r;
+  auto c = r - t*(1.66666666666666019037e-01 +
+               t*(-2.77777777770155933842e-03 +
+               t*(6.61375632143793436117e-05 +
+               t*(-1.65339022054652515390e-06 +
+               t*4.13813679705723846039e-08))));
+  auto y = 1. - ((lo - (r*c)/(2. - c)) - hi);
+
+  // Multiply by 2^k.  The low 12 bits of k hold k mod 2^12.
+  return y*from_bits((k + 1023) << 52);
+}
+
+inline double fast_log(double x) {
+  using namespace fast_math_detail;
+
+  // x = 2^k * m, sqrt(1/2) <= m < sqrt(2)
+  constexpr std::uint64_t sqrt_half = 0x3fe6a09e667f3bcdULL;
+  constexpr std::uint64_t exponent_mask = 0xfffULL << 52;
+  auto ix = as_bits(x);
+  auto tmp = ix - sqrt_half;
+  auto m = from_bits(ix - (tmp & exponent_mask));
+
+  // k (mod 2^12) is the top 12 bits of tmp; convert to double through the
+  // mantissa of 2^52 with an offset to keep it non-negative.
+  auto kbits = ((tmp >> 52) + 2048) & 0xfffULL;
+  auto kd = from_bits(as_bits(two52) | kbits) - (two52 + 2048.);
+
+  // log(1 + f) by the fdlibm polynomial.
+  auto f = m - 1.;
+  auto s = f/(2. + f);
+  auto z = s*s;
+  auto w = z*z;
+  auto t1 = w*(3.999999999940941908e-01 +
+               w*(2.222219843214978396e-01 +
+               w*1.531383769920937332e-01));
+  auto t2 = z*(6.666666666666735130e-01 +
+               w*(2.857142874366239149e-01 +
+               w*(1.818357216161805012e-01 +
+               w*1.479819860511658591e-01)));
+  auto R = t1 + t2;
+  auto hfsq = .5*f*f;
+  return kd*ln2_hi - ((hfsq - (s*(hfsq + R) + kd*ln2_lo)) - f);
+}
+
+inline double fast_pow(double x, double p) {
+  return fast_exp(p*fast_log(x));
+}
+
+}  // namespace trento
+
+#endif  // FAST_MATH_H
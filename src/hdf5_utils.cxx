@@ -29,6 +29,11 @@ bool filename_is_hdf5(const std::string& path) {
 
 #ifdef TRENTO_HDF5
 
+std::mutex& library_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
 H5::H5File try_open_file(const std::string& path, unsigned int flags) {
   if (!fs::exists(path))
     throw std::invalid_argument{"file '" + path + "' does not exist"};
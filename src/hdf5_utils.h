@@ -6,6 +6,7 @@
 #ifndef HDF5_UTILS_H
 #define HDF5_UTILS_H
 
+#include <mutex>
 #include <string>
 
 #ifdef TRENTO_HDF5
@@ -31,6 +32,12 @@ bool filename_is_hdf5(const std::string& path);
 
 #ifdef TRENTO_HDF5
 
+// The HDF5 library is only thread-safe if built with --enable-threadsafe, which
+// most distributions do not do.  Code that may call the library while other
+// threads are running (e.g. event generation threads reading nuclear
+// configurations while events are written) must hold this lock.
+std::mutex& library_mutex();
+
 // Open an HDF5 file object.
 // Throw std::invalid_argument if the file does not exist or is not valid HDF5.
 H5::H5File try_open_file(
@@ -56,7 +63,7 @@ inline typename std::enable_if<
   H5::DataSpace
 >::type
 make_dataspace(const Container& shape) {
-  return H5::DataSpace{shape.size(), shape.data()};
+  return H5::DataSpace{static_cast<int>(shape.size()), shape.data()};
 }
 
 #endif  // TRENTO_HDF5
@@ -5,6 +5,7 @@
 
 #include "nucleon.h"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <random>
@@ -16,6 +17,7 @@
 #include <boost/program_options/variables_map.hpp>
 
 #include "fwd_decl.h"
+#include "nucleus.h"
 
 namespace trento {
 
@@ -42,6 +44,17 @@ constexpr double trunc_radius_widths = 5.;
 // Maximum impact parameter for participation.
 constexpr double max_impact_widths = 6.;
 
+// Number of intervals in the tabulated participation probability.  The
+// function exp(-exp(c - b^2/4w^2)) is smooth on the scale of w^2, so linear
+// interpolation over 36w^2/1024 intervals is accurate to about 1e-5.
+constexpr std::size_t prob_table_size = 1024;
+
+// Number of pairs handled at once by the batched participation kernel.
+constexpr std::size_t participate_block_size = 64;
+
+// Number of sub-cell phases per axis of the deposition stamp bank.
+constexpr int nstamp_phases = 16;
+
 // Trivial helper function.
 template <typename T>
 constexpr T sqr(T value) {
@@ -111,6 +124,20 @@ double compute_cross_sec_param(const VarMap& var_map) {
   }
 }
 
+// Tabulate the non-participation probability exp(-exp(c - b^2/4w^2)) at
+// prob_table_size + 1 equally spaced nodes from zero to b^2 = max_impact_sqr,
+// with one padding entry so that interpolating at the last node stays in
+// range.
+std::vector<double> tabulate_one_minus_prob(
+    double cross_sec_param, double width_sqr, double max_impact_sqr) {
+  std::vector<double> table(prob_table_size + 2);
+  auto step = max_impact_sqr/prob_table_size;
+  for (std::size_t i = 0; i <= prob_table_size; ++i)
+    table[i] = std::exp(-std::exp(cross_sec_param - .25*i*step/width_sqr));
+  table.back() = table[prob_table_size];
+  return table;
+}
+
 }  // unnamed namespace
 
 NucleonProfile::NucleonProfile(const VarMap& var_map)
@@ -121,10 +148,85 @@ NucleonProfile::NucleonProfile(const VarMap& var_map)
 	  neg_one_div_four_width_sqr_(-.25/width_sqr_),
 	  one_div_four_pi_(0.5*math::double_constants::one_div_two_pi),
       cross_sec_param_(compute_cross_sec_param(var_map)),
+      one_minus_prob_table_(tabulate_one_minus_prob(
+        cross_sec_param_, width_sqr_, max_impact_sqr_)),
+      one_minus_prob_inv_step_(prob_table_size/max_impact_sqr_),
       fast_exp_(-.5*sqr(trunc_radius_widths), 0., 1000),
+      stamp_half_width_(static_cast<int>(std::ceil(
+        trunc_radius_widths*std::sqrt(width_sqr_)/
+        var_map["xy-step"].as<double>())) + 1),
+      stamp_size_(static_cast<std::size_t>(2*stamp_half_width_ + 2)),
       fluct_dist_(gamma_param_unit_mean(var_map["fluctuation"].as<double>())),
       prefactor_(math::double_constants::one_div_two_pi/width_sqr_),
-      with_ncoll_(var_map["ncoll"].as<bool>())
-{}
+      with_ncoll_(var_map["ncoll"].as<bool>() ||
+                  var_map["collision-vertices"].as<bool>())
+{
+  // Tabulate the stamp bank.  Cell j of the stamp for phase p has its center
+  // at (j - K - p/nstamp_phases) grid steps from the rounded nucleon position.
+  const auto dxy = var_map["xy-step"].as<double>();
+  stamps_.resize(nstamp_phases*stamp_size_);
+  stamp_distance_sqr_.resize(nstamp_phases*stamp_size_);
+  for (int p = 0; p < nstamp_phases; ++p) {
+    for (std::size_t j = 0; j < stamp_size_; ++j) {
+      auto d = (static_cast<double>(j) - stamp_half_width_ -
+                static_cast<double>(p)/nstamp_phases) * dxy;
+      auto k = static_cast<std::size_t>(p)*stamp_size_ + j;
+      stamp_distance_sqr_[k] = d*d;
+      stamps_[k] = gaussian_factor(d*d);
+    }
+  }
+}
+
+int NucleonProfile::stamp_phases() const {
+  return nstamp_phases;
+}
+
+std::size_t NucleonProfile::participate(Nucleus& A, std::size_t iA, Nucleus& B,
+                                        const std::size_t* iB,
+                                        const double* xB, const double* yB,
+                                        std::size_t n,
+                                        unsigned char* hit) const {
+  const double xA = A.x_data()[iA];
+  const double yA = A.y_data()[iA];
+  const double* table = one_minus_prob_table_.data();
+  const double fmax = static_cast<double>(prob_table_size);
+
+  double uniform[participate_block_size];
+  std::size_t nhits = 0;
+
+  for (std::size_t start = 0; start < n; start += participate_block_size) {
+    const auto m = std::min(participate_block_size, n - start);
+
+    // Draw the uniform numbers up front, one per pair, so the loop below is
+    // free of calls into the random engine.
+    for (std::size_t k = 0; k < m; ++k)
+      uniform[k] = random::canonical<double>();
+
+    // Same sampling as the single-pair participate(), i.e. the pair
+    // participates if (1 - P) < U.  Pairs beyond the maximum impact parameter
+    // are masked out rather than skipped.
+    for (std::size_t k = 0; k < m; ++k) {
+      double dx = xA - xB[start + k];
+      double dy = yA - yB[start + k];
+      double distance_sqr = dx*dx + dy*dy;
+      double f = std::min(distance_sqr*one_minus_prob_inv_step_, fmax);
+      auto i = static_cast<std::size_t>(f);
+      double frac = f - static_cast<double>(i);
+      double one_minus_prob = table[i] + frac*(table[i + 1] - table[i]);
+      hit[start + k] = static_cast<unsigned char>(
+        (distance_sqr <= max_impact_sqr_) & (one_minus_prob < uniform[k]));
+    }
+
+    for (std::size_t k = 0; k < m; ++k) {
+      if (hit[start + k]) {
+        A.set_participant(iA);
+        B.set_participant(iB[start + k]);
+        ++nhits;
+      }
+    }
+  }
+
+  return nhits;
+}
 
 }  // namespace trento
@@ -6,6 +6,9 @@
 #ifndef NUCLEON_H
 #define NUCLEON_H
 
+#include <cstddef>
+#include <vector>
+
 #include <boost/math/constants/constants.hpp>
 
 #include "fast_exp.h"
@@ -29,6 +32,9 @@ class NucleonProfile {
   /// The radius at which the nucleon profile is truncated.
   double radius() const;
 
+  /// The squared truncation radius.
+  double radius_sqr() const;
+
   /// The maximum impact parameter for participation.
   double max_impact() const;
 
@@ -36,10 +42,57 @@ class NucleonProfile {
   /// thickness function for a new nucleon.
   void fluctuate();
 
+  /// Discard any state the fluctuation distribution carries between draws, so
+  /// that subsequent fluctuations depend only on the random engine stream.
+  void reset_fluctuations();
+
   /// Compute the thickness function at a (squared) distance from the profile
   /// center.
   double thickness(double distance_sqr) const;
 
+  /// The current (fluctuated) thickness at the profile center.
+  double prefactor() const;
+
+  /// \rst
+  /// One factor `\exp(-d^2/2w^2)` of the Gaussian thickness function, which
+  /// factorizes along the *x* and *y* axes.  Exact and not truncated, i.e. the
+  /// product of the two factors times the prefactor agrees with thickness()
+  /// within the truncation radius up to the FastExp error.
+  /// \endrst
+  double gaussian_factor(double distance_sqr) const;
+
+  /// \rst
+  /// Bank of precomputed one-dimensional stamps for depositing the profile
+  /// onto a grid with step ``xy-step``.  A nucleon position along one axis is
+  /// rounded to the nearest of stamp_phases() sub-cell phases; the stamp for a
+  /// phase holds the Gaussian factors `\exp(-d^2/2w^2)` at the distances *d*
+  /// from the rounded position to the centers of 2*K* + 2 consecutive cells,
+  /// where *K* = stamp_half_width().  The cell containing the rounded
+  /// position is number *K*.  Since the Gaussian factorizes, the thickness at
+  /// a cell is the prefactor times the product of the *x* and *y* stamp
+  /// values, so deposition requires no exponentials.
+  ///
+  /// Rounding shifts the profile by at most ``xy-step``/2/stamp_phases() per
+  /// axis.  The maximum slope of `\exp(-d^2/2w^2)` is `e^{-1/2}/w`, so the
+  /// error at any cell is bounded by
+  ///
+  /// .. math::
+  ///
+  ///   |\Delta T| \le T(0) \, \frac{e^{-1/2}}{w} \,
+  ///                  \frac{\Delta_{xy}}{\mathtt{stamp\_phases}},
+  ///
+  /// e.g. 0.4% of the peak thickness for `w = 0.5` fm and
+  /// `\Delta_{xy} = 0.05` fm.  Integrated quantities are far more precise
+  /// since the profile is only shifted, not deformed.
+  /// \endrst
+  int stamp_phases() const;
+  int stamp_half_width() const;
+
+  /// The stamp for the given phase and the corresponding squared distances,
+  /// each an array of 2*stamp_half_width() + 2 values.
+  const double* stamp(int phase) const;
+  const double* stamp_distance_sqr(int phase) const;
+
   /// WK: same as above, but without the Gamma fluctuation, 
   /// used in the calculation of binary collision density 
   double deterministic_thickness(double distance_sqr) const;
@@ -47,9 +100,49 @@ class NucleonProfile {
   /// WK: return Tpp given bpp^2
   double norm_Tpp(double bpp_sqr) const;
 
+  /// \rst
+  /// The binary collision density of a colliding pair, i.e. the product of
+  /// the two unfluctuated nucleon profiles normalized by the overlap
+  /// `T_{pp}(b)`, is a single Gaussian
+  ///
+  /// .. math::
+  ///
+  ///   \frac{T(\mathbf r_A) T(\mathbf r_B)}{T_{pp}(b)}
+  ///     = \frac{1}{\pi w^2} \exp\biggl(-\frac{d^2}{w^2}\biggr)
+  ///
+  /// of width `w/\sqrt 2` about the midpoint of the pair, where *d* is the
+  /// distance from the midpoint; the impact parameter cancels.  Like the
+  /// nucleon profile, it factorizes along the *x* and *y* axes into
+  /// binary_collision_prefactor() and two exact binary_collision_factor()s,
+  /// and is truncated at the same number of its (narrower) widths, i.e. at the
+  /// squared radius binary_collision_radius_sqr() = radius_sqr()/2.
+  /// \endrst
+  double binary_collision_factor(double distance_sqr) const;
+  double binary_collision_prefactor() const;
+  double binary_collision_radius_sqr() const;
+
   /// Randomly determine if a pair of nucleons participates.
   bool participate(Nucleon& A, Nucleon& B) const;
 
+  /// \rst
+  /// Batched version of the above: sample participation of nucleon ``iA`` of
+  /// nucleus ``A`` with a block of ``n`` nucleons of nucleus ``B``.  The block
+  /// is given by the nucleon indices ``iB`` and their transverse positions
+  /// ``(xB, yB)`` as contiguous arrays, e.g. from a ``CellList``.  Sets
+  /// ``hit[k]`` to one if the pair with ``iB[k]`` participates (zero
+  /// otherwise), marks the participants in both nuclei, and returns the number
+  /// of participating pairs.
+  ///
+  /// Unlike the single-pair function, the collision probability is
+  /// interpolated from a table and one uniform number is drawn per pair, so
+  /// the inner loop has no branches and vectorizes.  Pairs of nucleons which
+  /// are both already participants are sampled like any other pair.
+  /// \endrst
+  std::size_t participate(Nucleus& A, std::size_t iA, Nucleus& B,
+                          const std::size_t* iB,
+                          const double* xB, const double* yB,
+                          std::size_t n, unsigned char* hit) const;
+
  private:
   /// Width of Gaussian thickness function.
   const double width_sqr_;
@@ -74,9 +167,21 @@ class NucleonProfile {
   /// cross section \sigma_{NN}.  Calculated in constructor.
   const double cross_sec_param_;
 
+  /// Table of the non-participation probability 1 - P(b^2) at equally spaced
+  /// b^2 from zero to max_impact^2, plus one padding entry, and the inverse of
+  /// the spacing.  Used by the batched participate().
+  const std::vector<double> one_minus_prob_table_;
+  const double one_minus_prob_inv_step_;
+
   /// Fast exponential for calculating the thickness profile.
   const FastExp<double> fast_exp_;
 
+  /// Stamp bank (see stamp()): half width in cells, stamp length, and all
+  /// stamps and squared distances stored contiguously by phase.
+  const int stamp_half_width_;
+  const std::size_t stamp_size_;
+  std::vector<double> stamps_, stamp_distance_sqr_;
+
   /// Fluctuation distribution.
   std::gamma_distribution<double> fluct_dist_;
 
@@ -169,6 +274,10 @@ inline double NucleonProfile::radius() const {
   return std::sqrt(trunc_radius_sqr_);
 }
 
+inline double NucleonProfile::radius_sqr() const {
+  return trunc_radius_sqr_;
+}
+
 inline double NucleonProfile::max_impact() const {
   return std::sqrt(max_impact_sqr_);
 }
@@ -178,12 +287,37 @@ inline void NucleonProfile::fluctuate() {
      math::double_constants::one_div_two_pi / width_sqr_;
 }
 
+inline void NucleonProfile::reset_fluctuations() {
+  fluct_dist_.reset();
+}
+
 inline double NucleonProfile::thickness(double distance_sqr) const {
   if (distance_sqr > trunc_radius_sqr_)
     return 0.;
   return prefactor_ * fast_exp_(neg_one_div_two_width_sqr_*distance_sqr);
 }
 
+inline int NucleonProfile::stamp_half_width() const {
+  return stamp_half_width_;
+}
+
+inline const double* NucleonProfile::stamp(int phase) const {
+  return stamps_.data() + static_cast<std::size_t>(phase)*stamp_size_;
+}
+
+inline const double* NucleonProfile::stamp_distance_sqr(int phase) const {
+  return stamp_distance_sqr_.data() +
+         static_cast<std::size_t>(phase)*stamp_size_;
+}
+
+inline double NucleonProfile::prefactor() const {
+  return prefactor_;
+}
+
+inline double NucleonProfile::gaussian_factor(double distance_sqr) const {
+  return std::exp(neg_one_div_two_width_sqr_*distance_sqr);
+}
+
 // WK
 inline double NucleonProfile::deterministic_thickness(double distance_sqr) const {
   if (distance_sqr > trunc_radius_sqr_)
@@ -198,6 +332,19 @@ inline double NucleonProfile::norm_Tpp(double bpp_sqr) const  {
 		* fast_exp_(neg_one_div_four_width_sqr_*bpp_sqr);
 }
 
+inline double NucleonProfile::binary_collision_factor(
+    double distance_sqr) const {
+  return std::exp(2.*neg_one_div_two_width_sqr_*distance_sqr);
+}
+
+inline double NucleonProfile::binary_collision_prefactor() const {
+  return 2.*math::double_constants::one_div_two_pi/width_sqr_;
+}
+
+inline double NucleonProfile::binary_collision_radius_sqr() const {
+  return .5*trunc_radius_sqr_;
+}
+
 inline bool NucleonProfile::participate(Nucleon& A, Nucleon& B) const {
   // If both nucleons are already participants, there's nothing to do, unless
   // in Ncoll mode
@@ -6,10 +6,18 @@
 #include "nucleus.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <condition_variable>
+#include <exception>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <utility>
 
 #include <boost/math/constants/constants.hpp>
@@ -32,7 +40,9 @@ double correct_a(double a, double w) {
    return std::sqrt(std::fmax(a*a - c*c*w*w, a_min*a_min));
 }
 
-NucleusPtr Nucleus::create(const std::string& species, double nucleon_width, double nucleon_dmin) {
+NucleusPtr Nucleus::create(const std::string& species, double nucleon_width,
+                           double nucleon_dmin, std::size_t config_cache,
+                           std::uint64_t seed) {
   // W-S params ref. in header
   // XXX: remember to add new species to the help output in main() and the readme
   if (species == "p")
@@ -78,7 +88,7 @@ NucleusPtr Nucleus::create(const std::string& species, double nucleon_width, dou
   // Read nuclear configurations from HDF5.
   else if (hdf5::filename_is_hdf5(species)) {
 #ifdef TRENTO_HDF5
-    return ManualNucleus::create(species);
+    return ManualNucleus::create(species, config_cache, seed);
 #else
     throw std::invalid_argument{"HDF5 output was not compiled"};
 #endif  // TRENTO_HDF5
@@ -87,7 +97,12 @@ NucleusPtr Nucleus::create(const std::string& species, double nucleon_width, dou
     throw std::invalid_argument{"unknown projectile species: " + species};
 }
 
-Nucleus::Nucleus(std::size_t A) : nucleons_(A), offset_(0) {}
+Nucleus::Nucleus(std::size_t A)
+    : nucleons_(A),
+      x_(A), y_(A), z_(A),
+      participant_(A, 0),
+      offset_(0)
+{}
 
 void Nucleus::sample_nucleons(double offset) {
   offset_ = offset;
@@ -97,6 +112,17 @@ void Nucleus::sample_nucleons(double offset) {
 void Nucleus::set_nucleon_position(
     iterator nucleon, double x, double y, double z) {
   nucleon->set_position(x + offset_, y, z);
+
+  auto i = static_cast<size_type>(nucleon - begin());
+  x_[i] = x + offset_;
+  y_[i] = y;
+  z_[i] = z;
+  participant_[i] = 0;
+}
+
+void Nucleus::set_participant(size_type index) {
+  nucleons_[index].set_participant();
+  participant_[index] = 1;
 }
 
 Proton::Proton() : Nucleus(1) {}
@@ -162,20 +188,101 @@ void Deuteron::sample_nucleons_impl() {
   set_nucleon_position(std::next(begin()), -x, -y, -z);
 }
 
+namespace {
+
+// The spatial hash of MinDistNucleus is a periodic grid of hash_cells^3 cells:
+// cell (ix, iy, iz) is bucket (ix, iy, iz) mod hash_cells.  Cells a period
+// apart share a bucket, which only adds candidates to check; for the usual
+// minimum distances (~1 fm) the period exceeds the size of the nucleus.  The
+// three buckets along z of each row of the 3x3x3 block are then adjacent.
+constexpr int hash_bits = 4;
+constexpr int hash_cells = 1 << hash_bits;
+constexpr int hash_mask = hash_cells - 1;
+
+// Offset of the cell indices, so that they are positive and truncation is
+// floor for positions within +-hash_offset cells.
+constexpr double hash_offset = 1 << 30;
+
+// The first nucleons placed (the smallest radii) are checked by a direct scan.
+// They fill the core, where the r^2 Jacobian leaves little room and most
+// rejections happen, and scanning a few nucleons is cheaper than the 27 cells.
+constexpr std::size_t direct_scan_max = 64;
+
+}  // unnamed namespace
+
 MinDistNucleus::MinDistNucleus(std::size_t A, double dmin)
     : Nucleus(A),
-      dminsq_(dmin*dmin)
+      dminsq_(dmin*dmin),
+      inv_cell_size_(dmin > 0. ? 1./dmin : 0.),
+      bucket_head_(hash_cells*hash_cells*hash_cells, -1),
+      bucket_next_(A),
+      nucleon_bucket_(A),
+      nplaced_(0)
 {}
 
-bool MinDistNucleus::is_too_close(const_iterator nucleon) const {
+int MinDistNucleus::cell_index(double x) const {
+  return static_cast<int>(x*inv_cell_size_ + hash_offset) & hash_mask;
+}
+
+std::size_t MinDistNucleus::bucket(int ix, int iy, int iz) {
+  return static_cast<std::size_t>(
+    (ix << (2*hash_bits)) | (iy << hash_bits) | iz);
+}
+
+bool MinDistNucleus::is_too_close(const_iterator nucleon) {
   if (dminsq_ < 1e-10)
     return false;
-  for (const_iterator nucleon2 = begin(); nucleon2 != nucleon; ++nucleon2) {
-    auto dx = nucleon->x() - nucleon2->x();
-    auto dy = nucleon->y() - nucleon2->y();
-    auto dz = nucleon->z() - nucleon2->z();
-    if (dx*dx + dy*dy + dz*dz < dminsq_)
-      return true;
+
+  const auto* xs = x_data();
+  const auto* ys = y_data();
+  const auto* zs = z_data();
+  const auto index = static_cast<std::size_t>(nucleon - cbegin());
+
+  // Placement restarted: clear the buckets of the previous nucleons.
+  if (index < nplaced_) {
+    for (std::size_t i = 0; i < nplaced_; ++i)
+      bucket_head_[nucleon_bucket_[i]] = -1;
+    nplaced_ = 0;
+  }
+
+  // Scan the first nucleons directly (see direct_scan_max).
+  const auto x = xs[index], y = ys[index], z = zs[index];
+  if (index < direct_scan_max) {
+    for (std::size_t i = 0; i < index; ++i) {
+      auto dx = x - xs[i];
+      auto dy = y - ys[i];
+      auto dz = z - zs[i];
+      if (dx*dx + dy*dy + dz*dz < dminsq_)
+        return true;
+    }
+    return false;
+  }
+
+  // Add the nucleons placed since the last check.
+  for (; nplaced_ < index; ++nplaced_) {
+    const auto b = bucket(cell_index(xs[nplaced_]), cell_index(ys[nplaced_]),
+                          cell_index(zs[nplaced_]));
+    nucleon_bucket_[nplaced_] = b;
+    bucket_next_[nplaced_] = bucket_head_[b];
+    bucket_head_[b] = static_cast<int>(nplaced_);
+  }
+
+  // Check the nucleons in the 3x3x3 block of cells around this one.
+  const auto ix = cell_index(x), iy = cell_index(y), iz = cell_index(z);
+  for (auto jx = ix - 1; jx <= ix + 1; ++jx) {
+    for (auto jy = iy - 1; jy <= iy + 1; ++jy) {
+      for (auto jz = iz - 1; jz <= iz + 1; ++jz) {
+        const auto b = bucket(jx & hash_mask, jy & hash_mask, jz & hash_mask);
+        for (auto i = bucket_head_[b]; i >= 0;
+             i = bucket_next_[static_cast<std::size_t>(i)]) {
+          auto dx = x - xs[i];
+          auto dy = y - ys[i];
+          auto dz = z - zs[i];
+          if (dx*dx + dy*dy + dz*dz < dminsq_)
+            return true;
+        }
+      }
+    }
   }
   return false;
 }
@@ -187,8 +294,9 @@ WoodsSaxonNucleus::WoodsSaxonNucleus(
     : MinDistNucleus(A, dmin),
       R_(R),
       a_(a),
-      woods_saxon_dist_(1000, 0., R + 10.*a,
-        [R, a](double r) { return r*r/(1.+std::exp((r-R)/a)); })
+      woods_saxon_dist_(
+        [R, a](double r) { return r*r/(1.+std::exp((r-R)/a)); }, R + 10.*a),
+      radii_(A)
 {}
 
 /// Return something a bit smaller than the true maximum radius.  The
@@ -208,14 +316,12 @@ void WoodsSaxonNucleus::sample_nucleons_impl() {
   // Because of the r^2 Jacobian, there is less available space at smaller
   // radii.  Therefore, pre-sample all radii first, sort them, and then place
   // nucleons starting with the smallest radius and working outwards.  This
-  // dramatically reduces the chance that a nucleon cannot be placed.
-  std::vector<double> radii(size());
-  for (auto&& r : radii)
-    r = woods_saxon_dist_(random::engine);
-  std::sort(radii.begin(), radii.end());
+  // dramatically reduces the chance that a nucleon cannot be placed.  The
+  // sampler draws the radii in increasing order, so they need no sort.
+  woods_saxon_dist_.sample_sorted(radii_.data(), radii_.size());
 
   // Place each nucleon at a pre-sampled radius.
-  auto r_iter = radii.cbegin();
+  auto r_iter = radii_.cbegin();
   for (iterator nucleon = begin(); nucleon != end(); ++nucleon) {
     // Get radius and advance iterator.
     auto& r = *r_iter++;
@@ -248,6 +354,18 @@ void WoodsSaxonNucleus::sample_nucleons_impl() {
   // XXX: re-center nucleon positions?
 }
 
+namespace {
+
+// Spacing of the grid of effective radii of DeformedWoodsSaxonNucleus, in
+// units of the surface thickness.  Proposals are accepted with probability at
+// least exp(-radius_step).
+constexpr double radius_step = .1;
+
+// Number of bins of the tabulated radial distributions at each grid point.
+constexpr std::size_t radius_bins = 256;
+
+}  // unnamed namespace
+
 // Set rmax like the non-deformed case (R + 10a), but for the maximum
 // "effective" radius.  The numerical coefficients for beta2 and beta4 are the
 // approximate values of Y20 and Y40 at theta = 0.
@@ -258,8 +376,41 @@ DeformedWoodsSaxonNucleus::DeformedWoodsSaxonNucleus(
       a_(a),
       beta2_(beta2),
       beta4_(beta4),
-      rmax_(R*(1. + .63*std::fabs(beta2) + .85*std::fabs(beta4)) + 10.*a)
-{}
+      rmax_(R*(1. + .63*std::fabs(beta2) + .85*std::fabs(beta4)) + 10.*a),
+      // The marginal dist of cos_theta, shifted to [0, 2], is the integral of
+      // r^2 times the W-S dist up to rmax, which is (Reff^3 + pi^2 a^2 Reff)/3
+      // minus the (exponential) tail beyond rmax, up to corrections of order
+      // exp(-Reff/a).
+      cos_theta_dist_([this](double x) {
+        using math::double_constants::pi_sqr;
+        const auto Reff = effective_radius(x - 1.);
+        return (Reff*Reff*Reff + pi_sqr*a_*a_*Reff)/3. -
+          a_*std::exp((Reff - rmax_)/a_)*(rmax_*rmax_ + 2.*a_*rmax_ + 2.*a_*a_);
+      }, 2.),
+      samples_(A),
+      cos_theta_buffer_(A),
+      nproposed_(0),
+      naccepted_(0) {
+  // The range of effective radii.  Y20 and Y40 are polynomials in cos_theta,
+  // so a fine scan finds their extrema.
+  Reff_min_ = Reff_max_ = effective_radius(1.);
+  for (auto i = 0; i < 1000; ++i) {
+    const auto Reff = effective_radius(i/1000.);
+    Reff_min_ = std::fmin(Reff_min_, Reff);
+    Reff_max_ = std::fmax(Reff_max_, Reff);
+  }
+
+  const auto nradii =
+    static_cast<std::size_t>(std::ceil((Reff_max_ - Reff_min_)/(radius_step*a)));
+  Reff_step_ = nradii > 0 ? (Reff_max_ - Reff_min_)/nradii : 0.;
+  radius_dists_.reserve(nradii + 1);
+  for (std::size_t k = 0; k <= nradii; ++k) {
+    const auto Reff = Reff_min_ + k*Reff_step_;
+    radius_dists_.emplace_back(
+      [Reff, a](double r) { return r*r/(1. + std::exp((r - Reff)/a)); },
+      rmax_, radius_bins);
+  }
+}
 
 /// Return something a bit smaller than the true maximum radius.  The
 /// Woods-Saxon distribution falls off very rapidly (exponentially), and since
@@ -269,8 +420,11 @@ double DeformedWoodsSaxonNucleus::radius() const {
   return rmax_ - 7.*a_;
 }
 
-double DeformedWoodsSaxonNucleus::deformed_woods_saxon_dist(
-    double r, double cos_theta) const {
+double DeformedWoodsSaxonNucleus::acceptance_rate() const {
+  return nproposed_ > 0 ? static_cast<double>(naccepted_)/nproposed_ : 1.;
+}
+
+double DeformedWoodsSaxonNucleus::effective_radius(double cos_theta) const {
   auto cos_theta_sq = cos_theta*cos_theta;
 
   // spherical harmonics
@@ -279,10 +433,7 @@ double DeformedWoodsSaxonNucleus::deformed_woods_saxon_dist(
   auto Y40 = 3./16. * one_div_root_pi *
              (35.*cos_theta_sq*cos_theta_sq - 30.*cos_theta_sq + 3.);
 
-  // "effective" radius
-  auto Reff = R_ * (1. + beta2_*Y20 + beta4_*Y40);
-
-  return 1. / (1. + std::exp((r - Reff) / a_));
+  return R_ * (1. + beta2_*Y20 + beta4_*Y40);
 }
 
 /// Sample deformed Woods-Saxon nucleon positions.
@@ -309,36 +460,57 @@ void DeformedWoodsSaxonNucleus::sample_nucleons_impl() {
 
   // Pre-sample and sort (r, cos_theta) points from the deformed W-S dist.
   // See comments in WoodsSaxonNucleus (above) for rationale.
-  struct Sample {
-    double r, cos_theta;
-  };
-
-  std::vector<Sample> samples(size());
-
-  for (auto&& sample : samples) {
-    // Sample (r, cos_theta) using a standard rejection method.
-    // Remember to include the phase-space factors.
+  //
+  // First sample cos_theta from its marginal dist, then r from its conditional
+  // dist at that cos_theta, a W-S dist of radius Reff(cos_theta).  Propose r
+  // from the tabulated W-S dist of the next larger grid radius Rk and accept
+  // with the ratio of the two W-S dists,
+  //
+  //   (1 + exp((r - Rk)/a)) / (1 + exp((r - Reff)/a)),
+  //
+  // which is between exp(-(Rk - Reff)/a) and one, so almost all proposals are
+  // accepted.  A uniform proposal in the sphere of radius rmax would accept
+  // only ~10% for uranium, each costing a cbrt() and an exp().
+  cos_theta_dist_.sample(cos_theta_buffer_.data(), cos_theta_buffer_.size());
+
+  auto c = cos_theta_buffer_.cbegin();
+  for (auto&& sample : samples_) {
+    sample.cos_theta = *c++ - 1.;
+    const auto Reff = effective_radius(sample.cos_theta);
+    const auto x = Reff_step_ > 0. ? (Reff - Reff_min_)/Reff_step_ : 0.;
+    const auto k = std::min(
+      static_cast<std::size_t>(std::ceil(std::fmax(x, 0.))),
+      radius_dists_.size() - 1);
+    const auto Rk = Reff_min_ + k*Reff_step_;
+    const auto& radius_dist = radius_dists_[k];
+
+    // Accept without computing the ratio below its lower bound.
+    const auto min_ratio = std::exp((Reff - Rk)/a_);
+    double u;
     do {
-      sample.r = rmax_ * std::cbrt(random::canonical<double>());
-      sample.cos_theta = random::cos_theta<double>();
+      sample.r = radius_dist(random::canonical<double>());
+      u = random::canonical<double>();
+      ++nproposed_;
     } while (
-      random::canonical<double>() >
-      deformed_woods_saxon_dist(sample.r, sample.cos_theta)
+      u > min_ratio &&
+      u*(1. + std::exp((sample.r - Reff)/a_)) >
+        1. + std::exp((sample.r - Rk)/a_)
     );
+    ++naccepted_;
   }
 
   // Sort by radius.  Could also sort by e.g. the perpendicular distance from
   // the z-axis, or by descending W-S density.  Empirically, radius leads to the
   // smallest failure rate.
   std::sort(
-    samples.begin(), samples.end(),
+    samples_.begin(), samples_.end(),
     [](const Sample& a, const Sample& b) {
       return a.r < b.r;
     }
   );
 
   // Place each nucleon at a pre-sampled (r, cos_theta).
-  auto sample = samples.cbegin();
+  auto sample = samples_.cbegin();
   for (iterator nucleon = begin(); nucleon != end(); ++nucleon, ++sample) {
     auto& r = sample->r;
     auto& cos_theta = sample->cos_theta;
@@ -382,6 +554,116 @@ void DeformedWoodsSaxonNucleus::sample_nucleons_impl() {
   }
 }
 
+namespace {
+
+// A uniformly random rotation in SO(3), composed of three Euler rotations.
+class RandomRotation {
+ public:
+  RandomRotation() {
+    // First is an azimuthal spin about the Z axis.
+    const auto angle_1 = random::phi<double>();
+    const auto c1 = std::cos(angle_1);
+    const auto s1 = std::sin(angle_1);
+    // Then a polar tilt about the original X axis, uniform in cos(theta).
+    const auto c2 = random::cos_theta<double>();
+    const auto s2 = std::sqrt(1. - c2*c2);
+    // Finally another azimuthal spin about the original Z axis.
+    const auto angle_3 = random::phi<double>();
+    const auto c3 = std::cos(angle_3);
+    const auto s3 = std::sin(angle_3);
+
+    m_ = {{
+      c1*c3 - c2*s1*s3, -(c3*s1 + c1*c2*s3),  s2*s3,
+      c1*s3 + c2*c3*s1, -(s1*s3 - c1*c2*c3), -c3*s2,
+      s1*s2,              c1*s2,              c2
+    }};
+  }
+
+  // Rotate the vector (x, y, z) in place.
+  void operator()(double& x, double& y, double& z) const {
+    const auto x_rot = m_[0]*x + m_[1]*y + m_[2]*z;
+    const auto y_rot = m_[3]*x + m_[4]*y + m_[5]*z;
+    z = m_[6]*x + m_[7]*y + m_[8]*z;
+    x = x_rot;
+    y = y_rot;
+  }
+
+ private:
+  std::array<double, 9> m_;
+};
+
+}  // unnamed namespace
+
+void NucleusPool::sample_config(Nucleus& generator, std::uint32_t stream,
+                                std::size_t index, Configs& configs) {
+  const auto A = generator.size();
+  if (configs.size() < 3*A*(index + 1))
+    configs.resize(3*A*(index + 1));
+
+  random::engine.seek(static_cast<std::uint32_t>(index), 0, stream);
+  generator.sample_nucleons(0.);
+
+  double xcm = 0., ycm = 0., zcm = 0.;
+  for (const auto& nucleon : generator) {
+    xcm += nucleon.x();
+    ycm += nucleon.y();
+    zcm += nucleon.z();
+  }
+  xcm /= A;
+  ycm /= A;
+  zcm /= A;
+
+  auto* position = configs.data() + 3*A*index;
+  for (const auto& nucleon : generator) {
+    *position++ = static_cast<float>(nucleon.x() - xcm);
+    *position++ = static_cast<float>(nucleon.y() - ycm);
+    *position++ = static_cast<float>(nucleon.z() - zcm);
+  }
+}
+
+NucleusPool::NucleusPool(std::shared_ptr<const Configs> configs,
+                         const Nucleus& generator)
+    : Nucleus(generator.size()),
+      configs_(std::move(configs)),
+      radius_(generator.radius()),
+      index_dist_(0, std::max(nconfigs(), std::size_t{1}) - 1),
+      ndraws_(0) {
+  if (nconfigs() == 0)
+    throw std::invalid_argument{"nucleus pool has no configurations"};
+}
+
+double NucleusPool::radius() const {
+  return radius_;
+}
+
+std::size_t NucleusPool::nconfigs() const {
+  return configs_->size()/(3*size());
+}
+
+std::size_t NucleusPool::memory() const {
+  return configs_->size()*sizeof(Configs::value_type);
+}
+
+std::size_t NucleusPool::ndraws() const {
+  return ndraws_;
+}
+
+void NucleusPool::sample_nucleons_impl() {
+  const RandomRotation rotate{};
+
+  const auto* position =
+    configs_->data() + 3*size()*index_dist_(random::engine);
+  for (iterator nucleon = begin(); nucleon != end(); ++nucleon) {
+    double x = *position++;
+    double y = *position++;
+    double z = *position++;
+    rotate(x, y, z);
+    set_nucleon_position(nucleon, x, y, z);
+  }
+
+  ++ndraws_;
+}
+
 #ifdef TRENTO_HDF5
 
 namespace {
@@ -406,7 +688,350 @@ read_dataset(
 
 }  // unnamed namespace
 
-std::unique_ptr<ManualNucleus> ManualNucleus::create(const std::string& path) {
+// A set of configurations, nucleon positions (x, y, z) back to back, and its
+// block number (see ConfigCache).
+struct ManualNucleus::ConfigBlock {
+  std::vector<float> positions;
+  std::size_t nconfigs;
+  std::uint32_t number;
+};
+
+// Configurations of a ManualNucleus held in memory (see the class
+// documentation).  All members except the blocks are set on construction.
+class ManualNucleus::ConfigCache {
+ public:
+  using Block = ConfigBlock;
+
+  // Read the whole dataset if it fits in cache_size MiB, otherwise start the
+  // background reader, with blocks chosen by an engine with the given seed.
+  ConfigCache(std::unique_ptr<H5::DataSet> dataset, std::size_t cache_size,
+              std::uint64_t seed);
+
+  // Stop the background reader.
+  ~ConfigCache();
+
+  // The number of the block of the given event.
+  std::uint32_t block_number(std::uint32_t event) const {
+    return full_ ? 0 : static_cast<std::uint32_t>(event/events_per_block_);
+  }
+
+  // The block to draw the configurations of the given event from.  Moving on
+  // to the next block swaps it in and starts reading the one after.  Waits for
+  // the background reader if the block is not ready yet (and rethrows its
+  // error).
+  std::shared_ptr<const Block> acquire(std::uint32_t event);
+
+  // Number of nucleons.
+  std::size_t nucleons() const { return A_; }
+
+  // Whether the whole dataset is in memory.
+  bool full() const { return full_; }
+
+ private:
+  // Read the given block of randomly chosen chunks, i.e. from that stream of
+  // the block engine.
+  std::shared_ptr<const Block> read_block(std::uint32_t number) const;
+
+  // Read configurations [first, first + n) into a buffer.
+  void read_configs(std::size_t first, std::size_t n, float* buffer) const;
+
+  // Loop of the background reader: read the block requested by acquire(), or
+  // else the block after the current one once it has been swapped in.
+  void read_ahead();
+
+  // Drop a block from the cache, but remember it while a nucleus still holds
+  // it.  Requires the lock.
+  void retire(std::shared_ptr<const Block>& block);
+
+  const std::unique_ptr<H5::DataSet> dataset_;
+  std::size_t nconfigs_, A_;
+
+  // Key of the engine that chooses the chunks of each block.
+  const std::uint64_t seed_;
+
+  // Configurations per chunk, chunks per block, and events per block.
+  std::size_t chunk_size_, block_chunks_, events_per_block_;
+
+  bool full_;
+
+  // The blocks before, at and after the current block number (null if not in
+  // memory), and a requested block other than those (if requested_).
+  std::shared_ptr<const Block> previous_, current_, next_;
+  std::uint32_t current_number_, requested_number_;
+  bool requested_;
+
+  // Blocks dropped from the cache, which are still in memory as long as a
+  // nucleus holds them (e.g. for an event that fell behind the others).
+  std::map<std::uint32_t, std::weak_ptr<const Block>> retired_;
+
+  // Protects the blocks and the stop flag and error of the background reader.
+  std::mutex mutex_;
+  std::condition_variable block_read_, block_needed_;
+  bool stop_;
+  std::exception_ptr error_;
+  std::thread reader_;
+};
+
+namespace {
+
+// Size of the reads of unchunked (contiguous) datasets.
+constexpr std::size_t contiguous_read_bytes = 1 << 20;
+
+}  // unnamed namespace
+
+ManualNucleus::ConfigCache::ConfigCache(
+    std::unique_ptr<H5::DataSet> dataset, std::size_t cache_size,
+    std::uint64_t seed)
+    : dataset_(std::move(dataset)),
+      seed_(seed),
+      current_number_(0),
+      requested_number_(0),
+      requested_(false),
+      stop_(false) {
+  std::array<hsize_t, 3> shape;
+  dataset_->getSpace().getSimpleExtentDims(shape.data());
+  nconfigs_ = shape[0];
+  A_ = shape[1];
+
+  const auto config_bytes = 3*A_*sizeof(float);
+  const auto cache_bytes = cache_size << 20;
+  full_ = nconfigs_*config_bytes <= cache_bytes;
+
+  if (full_) {
+    auto block = std::make_shared<Block>();
+    block->positions.resize(3*A_*nconfigs_);
+    block->nconfigs = nconfigs_;
+    block->number = 0;
+    read_configs(0, nconfigs_, block->positions.data());
+    current_ = std::move(block);
+    return;
+  }
+
+  // Read whole chunks of chunked (e.g. compressed) datasets, so that each is
+  // decompressed once per block.
+  const auto plist = dataset_->getCreatePlist();
+  if (plist.getLayout() == H5D_CHUNKED) {
+    std::array<hsize_t, 3> chunk_dims;
+    plist.getChunk(3, chunk_dims.data());
+    chunk_size_ = chunk_dims[0];
+  } else {
+    chunk_size_ = std::max(contiguous_read_bytes/config_bytes, std::size_t{1});
+  }
+  const auto nchunks = (nconfigs_ + chunk_size_ - 1)/chunk_size_;
+  block_chunks_ = std::min(
+    std::max(cache_bytes/3/(chunk_size_*config_bytes), std::size_t{1}),
+    nchunks);
+
+  // Assume that each event draws two nuclei from this file, i.e. both
+  // projectiles and one try, so that the events of a block draw about as many
+  // configurations as it holds.  Otherwise the configurations of a block are
+  // drawn fewer (one projectile) or more times (many impact parameter tries
+  // per event) on average.  The number of tries is only known once the events
+  // are generated, and the blocks must not depend on that to be reproducible.
+  events_per_block_ = std::max(block_chunks_*chunk_size_/2, std::size_t{1});
+
+  // The first block is read on demand, since it depends on the first event.
+  reader_ = std::thread{&ConfigCache::read_ahead, this};
+}
+
+ManualNucleus::ConfigCache::~ConfigCache() {
+  if (reader_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      stop_ = true;
+    }
+    block_needed_.notify_one();
+    reader_.join();
+  }
+}
+
+std::shared_ptr<const ManualNucleus::ConfigCache::Block>
+ManualNucleus::ConfigCache::acquire(std::uint32_t event) {
+  // The whole dataset never changes.
+  if (full_)
+    return current_;
+
+  const auto number = block_number(event);
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    if (error_)
+      std::rethrow_exception(error_);
+
+    if (current_) {
+      if (number == current_number_)
+        return current_;
+      if (number + 1 == current_number_ && previous_)
+        return previous_;
+      if (number == current_number_ + 1 && next_) {
+        // Move on, and read ahead the block after this one.
+        retire(previous_);
+        previous_ = std::move(current_);
+        current_ = std::move(next_);
+        next_.reset();
+        current_number_ = number;
+        block_needed_.notify_one();
+        return current_;
+      }
+    }
+
+    // A block well behind the current one is only needed by an event that
+    // fell far behind all others.  Usually a nucleus still holds it, e.g. the
+    // other projectile of the event (see ManualNucleus::sample_nucleons_impl).
+    // Otherwise it is read directly rather than evicting the others.
+    if (current_ && number < current_number_) {
+      const auto retired = retired_.find(number);
+      if (retired != retired_.end()) {
+        if (auto block = retired->second.lock())
+          return block;
+      }
+      break;
+    }
+
+    // Any block other than the next one (which is being read) replaces the
+    // current block, e.g. for the first event.
+    if (!current_ || number > current_number_ + 1) {
+      if (!requested_ || number > requested_number_) {
+        requested_number_ = number;
+        requested_ = true;
+        block_needed_.notify_one();
+      }
+    }
+
+    block_read_.wait(lock);
+  }
+
+  lock.unlock();
+  return read_block(number);
+}
+
+std::shared_ptr<const ManualNucleus::ConfigCache::Block>
+ManualNucleus::ConfigCache::read_block(std::uint32_t number) const {
+  // Choose distinct chunks by a partial Fisher-Yates shuffle and read them in
+  // file order.
+  const auto nchunks = (nconfigs_ + chunk_size_ - 1)/chunk_size_;
+  std::vector<std::size_t> chunks(nchunks);
+  std::iota(chunks.begin(), chunks.end(), std::size_t{0});
+  // Stream 3 of the run's engine, distinct from the events (0) and the nucleus
+  // pools (1, 2).
+  random::Engine engine{seed_};
+  engine.seek(number, 0, 3);
+  for (std::size_t i = 0; i < block_chunks_; ++i) {
+    std::uniform_int_distribution<std::size_t> dist{i, nchunks - 1};
+    std::swap(chunks[i], chunks[dist(engine)]);
+  }
+  chunks.resize(block_chunks_);
+  std::sort(chunks.begin(), chunks.end());
+
+  auto block = std::make_shared<Block>();
+  block->positions.resize(3*A_*chunk_size_*block_chunks_);
+  block->nconfigs = 0;
+  block->number = number;
+  for (const auto& chunk : chunks) {
+    const auto first = chunk*chunk_size_;
+    const auto n = std::min(chunk_size_, nconfigs_ - first);
+    read_configs(first, n, &block->positions[3*A_*block->nconfigs]);
+    block->nconfigs += n;
+  }
+  block->positions.resize(3*A_*block->nconfigs);
+
+  return block;
+}
+
+void ManualNucleus::ConfigCache::read_configs(
+    std::size_t first, std::size_t n, float* buffer) const {
+  std::array<hsize_t, 3> count = {n, A_, 3};
+  std::array<hsize_t, 3> start = {first, 0, 0};
+
+  std::lock_guard<std::mutex> lock{hdf5::library_mutex()};
+  auto filespace = dataset_->getSpace();
+  filespace.selectHyperslab(H5S_SELECT_SET, count.data(), start.data());
+  auto memspace = hdf5::make_dataspace(count);
+  dataset_->read(buffer, hdf5::type<float>(), memspace, filespace);
+}
+
+void ManualNucleus::ConfigCache::read_ahead() {
+  while (true) {
+    std::uint32_t number;
+    bool replace;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      block_needed_.wait(lock, [this]() {
+        return stop_ || requested_ || (current_ && !next_);
+      });
+      if (stop_)
+        return;
+      replace = requested_;
+      number = replace ? requested_number_ : current_number_ + 1;
+    }
+
+    // Read without holding the lock, so that draws from the current block
+    // continue meanwhile.
+    try {
+      auto block = read_block(number);
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (replace) {
+        // A later request supersedes this one.
+        if (requested_number_ == number) {
+          retire(previous_);
+          retire(current_);
+          retire(next_);
+          current_ = std::move(block);
+          current_number_ = number;
+          requested_ = false;
+        }
+      } else if (!requested_ && number == current_number_ + 1) {
+        next_ = std::move(block);
+      }
+    }
+    catch (...) {
+      std::lock_guard<std::mutex> lock{mutex_};
+      error_ = std::current_exception();
+      block_read_.notify_all();
+      return;
+    }
+    block_read_.notify_all();
+  }
+}
+
+void ManualNucleus::ConfigCache::retire(std::shared_ptr<const Block>& block) {
+  for (auto retired = retired_.begin(); retired != retired_.end();) {
+    if (retired->second.expired())
+      retired = retired_.erase(retired);
+    else
+      ++retired;
+  }
+  if (block) {
+    retired_[block->number] = block;
+    block.reset();
+  }
+}
+
+std::unique_ptr<ManualNucleus> ManualNucleus::create(
+    const std::string& path, std::size_t cache_size, std::uint64_t seed) {
+  // Nuclei created from the same file share its cache, if they also have the
+  // same cache size and seed.  Keep track of the
+  // caches in use (the nuclei own them).
+  struct CacheEntry {
+    std::weak_ptr<ConfigCache> cache;
+    double rmax;
+  };
+  static std::mutex registry_mutex;
+  static std::map<std::tuple<std::string, std::size_t, std::uint64_t>,
+                  CacheEntry> registry;
+
+  std::lock_guard<std::mutex> registry_lock{registry_mutex};
+  const auto key = std::make_tuple(path, cache_size, seed);
+  const auto entry = registry.find(key);
+  if (entry != registry.end()) {
+    if (auto cache = entry->second.cache.lock()) {
+      const auto A = cache->nucleons();
+      return std::unique_ptr<ManualNucleus>{
+        new ManualNucleus{std::move(cache), A, entry->second.rmax}
+      };
+    }
+  }
+
   auto file = hdf5::try_open_file(path);
 
   // Check that there is a single dataset in the file.
@@ -448,8 +1073,13 @@ std::unique_ptr<ManualNucleus> ManualNucleus::create(const std::string& path) {
     };
 
   // Deduce number of configs and number of nucleons (A) from the shape.
-  const auto& nconfigs = shape[0];
-  const auto& A = shape[1];
+  const auto nconfigs = shape[0];
+  const auto A = shape[1];
+
+  if (nconfigs == 0 || A == 0)
+    throw std::invalid_argument{
+      "dataset '" + name + "' in file '" + path + "' is empty"
+    };
 
   // Estimate the max radius from at least 500 nucleon positions.
   auto n = std::min(500/A + 1, nconfigs);
@@ -471,17 +1101,20 @@ std::unique_ptr<ManualNucleus> ManualNucleus::create(const std::string& path) {
 
   auto rmax = std::sqrt(rmax_sq);
 
+  auto cache = std::make_shared<ConfigCache>(
+    std::move(dataset), cache_size, seed);
+  registry[key] = CacheEntry{cache, rmax};
+
   return std::unique_ptr<ManualNucleus>{
-    new ManualNucleus{std::move(dataset), nconfigs, A, rmax}
+    new ManualNucleus{std::move(cache), A, rmax}
   };
 }
 
-ManualNucleus::ManualNucleus(std::unique_ptr<H5::DataSet> dataset,
-                             std::size_t nconfigs, std::size_t A, double rmax)
+ManualNucleus::ManualNucleus(std::shared_ptr<ConfigCache> cache,
+                             std::size_t A, double rmax)
     : Nucleus(A),
-      dataset_(std::move(dataset)),
-      rmax_(rmax),
-      index_dist_(0, nconfigs - 1)
+      cache_(std::move(cache)),
+      rmax_(rmax)
 {}
 
 ManualNucleus::~ManualNucleus() = default;
@@ -490,41 +1123,30 @@ double ManualNucleus::radius() const {
   return rmax_;
 }
 
-void ManualNucleus::sample_nucleons_impl() {
-  // Sample Euler rotation angles.
-  // First is an azimuthal spin about the Z axis.
-  const auto angle_1 = random::phi<double>();
-  const auto c1 = std::cos(angle_1);
-  const auto s1 = std::sin(angle_1);
-  // Then a polar tilt about the original X axis, uniform in cos(theta).
-  const auto c2 = random::cos_theta<double>();
-  const auto s2 = std::sqrt(1. - c2*c2);
-  // Finally another azimuthal spin about the original Z axis.
-  const auto angle_3 = random::phi<double>();
-  const auto c3 = std::cos(angle_3);
-  const auto s3 = std::sin(angle_3);
-
-  // Choose and read a random config from the dataset.
-  std::array<hsize_t, 3> count = {1, size(), 3};
-  std::array<hsize_t, 3> start = {index_dist_(random::engine), 0, 0};
-  std::array<hsize_t, 2> shape = {size(), 3};
-  const auto positions = read_dataset<float>(*dataset_, count, start, shape);
-
-  // Loop over positions and nucleons.
-  auto positions_iter = positions.begin();
-  for (iterator nucleon = begin(); nucleon != end(); ++nucleon) {
-    // Extract position vector and increment iterator.
-    auto position = *positions_iter++;
-    auto& x = position[0];
-    auto& y = position[1];
-    auto& z = position[2];
+bool ManualNucleus::fully_cached() const {
+  return cache_->full();
+}
 
-    // Rotate.
-    auto x_rot = x*(c1*c3 - c2*s1*s3) - y*(c3*s1 + c1*c2*s3) + z*s2*s3;
-    auto y_rot = x*(c1*s3 + c2*c3*s1) - y*(s1*s3 - c1*c2*c3) - z*c3*s2;
-    auto z_rot = x*s1*s2              + y*c1*s2              + z*c2;
+void ManualNucleus::sample_nucleons_impl() {
+  const RandomRotation rotate{};
+
+  // Choose a random config from the block of the current event.  Keep the
+  // block, so that the other tries of the event (and of the following events
+  // of the block) need not acquire it again, even if the cache has dropped it.
+  const auto event = random::engine.event();
+  if (!block_ || block_->number != cache_->block_number(event))
+    block_ = cache_->acquire(event);
+  std::uniform_int_distribution<std::size_t> index_dist{
+    0, block_->nconfigs - 1};
+  const auto* position =
+    block_->positions.data() + 3*size()*index_dist(random::engine);
 
-    set_nucleon_position(nucleon, x_rot, y_rot, z_rot);
+  for (iterator nucleon = begin(); nucleon != end(); ++nucleon) {
+    double x = *position++;
+    double y = *position++;
+    double z = *position++;
+    rotate(x, y, z);
+    set_nucleon_position(nucleon, x, y, z);
   }
 }
 
@@ -6,6 +6,7 @@
 #ifndef NUCLEUS_H
 #define NUCLEUS_H
 
+#include <cstdint>
 #include <memory>
 #include <random>
 #include <string>
@@ -13,13 +14,7 @@
 
 #include "fwd_decl.h"
 #include "nucleon.h"
-
-#ifdef TRENTO_HDF5
-// forward declaration for std::unique_ptr<H5::DataSet> member of ManualNucleus
-namespace H5 {
-class DataSet;
-}
-#endif
+#include "radial_sampler.h"
 
 namespace trento {
 
@@ -55,11 +50,18 @@ class Nucleus {
   /// \param species standard symbol, e.g. "p" for proton or "Pb" for lead-208
   /// \param nucleon_dmin minimum nucleon-nucleon distance for Woods-Saxon
   /// nuclei (optional, default zero)
+  /// \param config_cache memory for configurations read from HDF5 files in
+  /// MiB (optional, see ManualNucleus)
+  /// \param seed key of the random engine that divides HDF5 files larger than
+  /// the cache into blocks (optional, see ManualNucleus)
   ///
   /// \return a smart pointer \c std::unique_ptr<Nucleus>
   ///
   /// \throw std::invalid_argument for unknown species
-  static NucleusPtr create(const std::string& species, double nucleon_width, double nucleon_dmin = 0);
+  static NucleusPtr create(const std::string& species, double nucleon_width,
+                           double nucleon_dmin = 0,
+                           std::size_t config_cache = 1024,
+                           std::uint64_t seed = 0);
 
   /// Default virtual destructor for abstract base class.
   virtual ~Nucleus() = default;
@@ -98,6 +100,22 @@ class Nucleus {
   const_iterator cend() const noexcept
   { return nucleons_.cend(); }
 
+  /// \rst
+  /// Structure-of-arrays view of the nucleons: contiguous x, y, z positions
+  /// and participant flags, in the same order as the ``Nucleon`` objects.
+  /// Positions are kept in sync by set_nucleon_position().  Participant flags
+  /// are set by the batched NucleonProfile::participate() kernel; the
+  /// single-pair overload only updates the ``Nucleon`` objects.
+  /// \endrst
+  const double* x_data() const noexcept
+  { return x_.data(); }
+  const double* y_data() const noexcept
+  { return y_.data(); }
+  const double* z_data() const noexcept
+  { return z_.data(); }
+  const unsigned char* participant_data() const noexcept
+  { return participant_.data(); }
+
  protected:
   /// Constructor only accessible by derived classes.
   /// \param A number of nucleons
@@ -112,6 +130,14 @@ class Nucleus {
   void set_nucleon_position(iterator nucleon, double x, double y, double z);
 
  private:
+  /// The NucleonProfile samples participants so must be able to set
+  /// participation status.
+  friend class NucleonProfile;
+
+  /// Mark a nucleon as a participant in both the Nucleon objects and the
+  /// structure-of-arrays flags.
+  void set_participant(size_type index);
+
   /// Internal interface to the actual implementation of the nucleon sampling
   /// algorithm, used in public function sample_nucleons().  This function must
   /// sample nucleon positions relative to the origin and set them using the
@@ -121,6 +147,10 @@ class Nucleus {
   /// Internal storage of Nucleon objects.
   std::vector<Nucleon> nucleons_;
 
+  /// Structure-of-arrays copies of the positions and participant flags.
+  std::vector<double> x_, y_, z_;
+  std::vector<unsigned char> participant_;
+
   /// Offset of nucleon x-positions.
   /// This variable is reset upon each call of sample_nucleons() and is read by
   /// set_nucleon_position().
@@ -187,12 +217,31 @@ class MinDistNucleus : public Nucleus {
   /// Check if a ``Nucleon`` is too close (within the minimum distance) of any
   /// previously placed nucleons.  Specifically, check nucleons from ``begin()``
   /// up to the given iterator.
+  ///
+  /// The placed nucleons are binned in a 3D spatial hash of cubic cells of
+  /// side the minimum distance, so only the 27 cells around the nucleon are
+  /// checked.  Nucleons are added to the hash as placement moves past them,
+  /// and it is cleared when placement restarts from ``begin()``, so the
+  /// nucleons must be placed in order (any number of checks per nucleon).
+  /// The first few nucleons are checked by a direct scan instead.
   /// \endrst
-  bool is_too_close(const_iterator nucleon) const;
+  bool is_too_close(const_iterator nucleon);
 
  private:
-  /// Internal storage of squared minimum distance.
-  const double dminsq_;
+  /// Internal storage of squared minimum distance, and the inverse cell size
+  /// of the spatial hash.
+  const double dminsq_, inv_cell_size_;
+
+  /// Periodic cell index of a coordinate, and the bucket of a cell.
+  int cell_index(double x) const;
+  static std::size_t bucket(int ix, int iy, int iz);
+
+  /// Spatial hash: the first nucleon (index, or -1 if none) of each bucket,
+  /// the next nucleon of the same bucket for each nucleon, and the bucket of
+  /// each nucleon.  The first nplaced_ nucleons are in the hash.
+  std::vector<int> bucket_head_, bucket_next_;
+  std::vector<std::size_t> nucleon_bucket_;
+  std::size_t nplaced_;
 };
 
 /// \rst
@@ -224,10 +273,12 @@ class WoodsSaxonNucleus : public MinDistNucleus {
   /// Woods-Saxon parameters.
   const double R_, a_;
 
-  /// Woods-Saxon distribution object.  Since the dist does not have an analytic
-  /// inverse CDF, approximate it as a piecewise linear dist.  For a large
-  /// number of steps this is very accurate.
-  mutable std::piecewise_linear_distribution<double> woods_saxon_dist_;
+  /// Sampler of Woods-Saxon radii.  Since the dist does not have an analytic
+  /// inverse CDF, it is tabulated (see RadialSampler), which is very accurate.
+  RadialSampler woods_saxon_dist_;
+
+  /// Scratch space of the sorted radii of an event.
+  std::vector<double> radii_;
 };
 
 /// \rst
@@ -257,26 +308,145 @@ class DeformedWoodsSaxonNucleus : public MinDistNucleus {
   /// parameters (R, a, beta2, beta4).
   virtual double radius() const override;
 
+  /// Fraction of proposed nucleon radii that have been accepted so far.
+  double acceptance_rate() const;
+
+  /// Numbers of proposed and accepted nucleon radii so far.
+  std::size_t nproposed() const
+  { return nproposed_; }
+  std::size_t naccepted() const
+  { return naccepted_; }
+
  private:
   /// Sample deformed Woods-Saxon nucleon positions.
   virtual void sample_nucleons_impl() override;
 
-  /// Evaluate the deformed Woods-Saxon distribution.
-  double deformed_woods_saxon_dist(double r, double cos_theta) const;
+  /// The "effective" radius R(1 + beta2 Y20 + beta4 Y40) of the deformed
+  /// Woods-Saxon distribution at a polar angle.
+  double effective_radius(double cos_theta) const;
 
   /// Woods-Saxon parameters.
   const double R_, a_, beta2_, beta4_;
 
   /// Maximum radius.
   const double rmax_;
+
+  /// Sampler of cos_theta (shifted by one to [0, 2]) from the distribution
+  /// integrated over r.
+  RadialSampler cos_theta_dist_;
+
+  /// Range of effective radii and the spacing of the grid of radii at which
+  /// the (spherical) Woods-Saxon radial distribution is tabulated.
+  double Reff_min_, Reff_max_, Reff_step_;
+  std::vector<RadialSampler> radius_dists_;
+
+  /// Scratch space of the (r, cos_theta) samples of an event.
+  struct Sample {
+    double r, cos_theta;
+  };
+  std::vector<Sample> samples_;
+  std::vector<double> cos_theta_buffer_;
+
+  /// Number of proposed and accepted radii.
+  std::size_t nproposed_, naccepted_;
+};
+
+/// \rst
+/// A fixed pool of nucleus configurations, pre-sampled from another nucleus
+/// (option ``--nucleus-pool``).  Each sample draws a random configuration and
+/// applies a random rotation, like ManualNucleus does for configurations read
+/// from a file, so sampling costs the same for all species regardless of e.g.
+/// the minimum distance or deformation.  Events then share configurations,
+/// which correlates them slightly; the pool should be large compared to the
+/// number of times each configuration is reused.
+///
+/// The configurations are read-only and shared between all pools created from
+/// the same storage (e.g. by each event generation thread).
+///
+/// Example::
+///
+///   auto configs = std::make_shared<NucleusPool::Configs>();
+///   auto generator = Nucleus::create("U", .5, 1.);
+///   for (std::size_t i = 0; i < 1000; ++i)
+///     NucleusPool::sample_config(*generator, 1, i, *configs);
+///   NucleusPool pool{configs, *generator};
+///   pool.sample_nucleons(0.);
+///
+/// \endrst
+class NucleusPool : public Nucleus {
+ public:
+  /// Storage of the configurations: x, y, z of each nucleon, back to back.
+  using Configs = std::vector<float>;
+
+  /// Sample configuration number ``index`` of a nucleus into the storage,
+  /// growing it if necessary.  The configuration is drawn from the random
+  /// stream (index, 0, stream), so it does not depend on which thread samples
+  /// it, and it is recentred so that its center of mass is at the origin.
+  static void sample_config(Nucleus& generator, std::uint32_t stream,
+                            std::size_t index, Configs& configs);
+
+  /// Sample from the given configurations of the generator nucleus, which sets
+  /// the number of nucleons and the radius.
+  NucleusPool(std::shared_ptr<const Configs> configs, const Nucleus& generator);
+
+  /// The radius of the generator nucleus.
+  virtual double radius() const override;
+
+  /// Number of configurations.
+  std::size_t nconfigs() const;
+
+  /// Memory used by the configurations, in bytes.
+  std::size_t memory() const;
+
+  /// Number of configurations drawn so far.
+  std::size_t ndraws() const;
+
+ private:
+  /// Draw a configuration, rotate it, and set nucleon positions.
+  virtual void sample_nucleons_impl() override;
+
+  /// The shared configurations.
+  const std::shared_ptr<const Configs> configs_;
+
+  /// Internal storage of the generator radius.
+  const double radius_;
+
+  /// Distribution for choosing random configs.
+  std::uniform_int_distribution<std::size_t> index_dist_;
+
+  /// Number of draws.
+  std::size_t ndraws_;
 };
 
 #ifdef TRENTO_HDF5
 
+/// \rst
 /// Reads manual nuclear configurations from an HDF5 file.
+///
+/// The configurations are held in memory, so that sampling a nucleus makes no
+/// HDF5 call.  If the dataset fits in the cache (option ``--config-cache``),
+/// it is read entirely on creation.  Otherwise the dataset is divided into
+/// numbered blocks of randomly chosen chunks, each using a third of the cache,
+/// and each event draws from the block given by its event number (from the
+/// random engine, see random::Philox).  The chunks of each block are chosen by
+/// an engine with the run's seed, so runs with different seeds draw from
+/// different blocks.  Consecutive events share a block, so
+/// the cache holds the current block, the previous one for events still in
+/// progress, and the next one, which a background thread reads ahead.  Each
+/// nucleus also keeps the block of its last event, so that an event that falls
+/// further behind does not read its block again (memory may then briefly
+/// exceed the cache size).  A block serves as many events as half the
+/// configurations it holds, i.e. it assumes that each event draws two nuclei
+/// from the file.  Since the block is a function of the event number, every
+/// event is reproducible on its own, as with the other nuclei.
+///
+/// All nuclei created from the same file share its cache (e.g. one per event
+/// generation thread, or both projectiles).
+/// \endrst
 class ManualNucleus : public Nucleus {
  public:
-  /// Create a ManualNucleus that reads from the given file.
+  /// Create a ManualNucleus that reads from the given file, with the given
+  /// cache size in MiB and the given seed of the block engine.
   /// Throw std::invalid_argument if there are any problems.
   ///
   /// Since this is a derived class, the base Nucleus class is initialized
@@ -285,7 +455,9 @@ class ManualNucleus : public Nucleus {
   /// must be deduced from the file.  As a workaround, this factory function
   /// opens the file, determines the number of nucleons, and then calls the
   /// constructor.
-  static std::unique_ptr<ManualNucleus> create(const std::string& path);
+  static std::unique_ptr<ManualNucleus> create(const std::string& path,
+                                               std::size_t cache_size = 1024,
+                                               std::uint64_t seed = 0);
 
   /// Must define destructor because of member pointer to incomplete type.
   /// See explanation for Collider destructor.
@@ -295,26 +467,33 @@ class ManualNucleus : public Nucleus {
   /// saving the maximum.
   virtual double radius() const override;
 
+  /// Whether the whole dataset is held in memory.
+  bool fully_cached() const;
+
  private:
+  /// Configurations held in memory and the reader that refills them, and a
+  /// block of configurations.  Defined in the implementation file.
+  class ConfigCache;
+  struct ConfigBlock;
+
   /// Private constructor -- use create().
-  /// \param dataset smart pointer to HDF5 dataset
-  /// \param nconfigs number of nucleus configs in the dataset
+  /// \param cache the (shared) configuration cache
   /// \param A number of nucleons
   /// \param rmax max radius
-  ManualNucleus(std::unique_ptr<H5::DataSet> dataset,
-                std::size_t nconfigs, std::size_t A, double rmax);
+  ManualNucleus(std::shared_ptr<ConfigCache> cache, std::size_t A, double rmax);
 
-  /// Read a configuration from the file, rotate it, and set nucleon positions.
+  /// Draw a configuration from the cache, rotate it, and set nucleon
+  /// positions.
   virtual void sample_nucleons_impl() override;
 
-  /// Internal pointer to HDF5 dataset object (PIMPL-like).
-  const std::unique_ptr<H5::DataSet> dataset_;
+  /// Internal pointer to the configuration cache (PIMPL-like).
+  const std::shared_ptr<ConfigCache> cache_;
+
+  /// The block of the last sampled event.
+  std::shared_ptr<const ConfigBlock> block_;
 
   /// Internal storage of the maximum radius.
   const double rmax_;
-
-  /// Distribution for choosing random configs.
-  std::uniform_int_distribution<std::size_t> index_dist_;
 };
 
 #endif  // TRENTO_HDF5
@@ -6,9 +6,13 @@
 #include "output.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
@@ -40,10 +44,10 @@ void write_stream(std::ostream& os, int width,
      << fixed;
 
   for (const auto& ecc : event.eccentricity())
-    os << setw(14) << ecc.second;
+    os << setw(14) << ecc;
 
   //for (const auto& psi : event.event_planes())
-  //  os << setw(14) << psi.second;
+  //  os << setw(14) << psi;
 
   os << '\n';
 }
@@ -64,30 +68,74 @@ void write_text_file(const fs::path& output_dir, int width,
         << "# npart = " << event.npart()        << '\n'
         << "# mult  = " << event.multiplicity() << '\n';
 
-    for (const auto& ecc : event.eccentricity())
-      ofs << "# e" << ecc.first << "    = " << ecc.second << '\n';
+    const auto& harmonics = event.harmonics();
+    for (std::size_t k = 0; k < harmonics.size(); ++k)
+      ofs << "# e" << harmonics[k] << "    = "
+          << event.eccentricity()[k] << '\n';
 
-    for (const auto& psi : event.event_planes())
-      ofs << "# psi" << psi.first << "    = " << psi.second << '\n';
+    for (std::size_t k = 0; k < harmonics.size(); ++k)
+      ofs << "# psi" << harmonics[k] << "    = "
+          << event.event_planes()[k] << '\n';
   }
 
   // Write IC profile as a block grid.  Use C++ default float format (not
   // fixed-width) so that trailing zeros are omitted.  This significantly
   // increases output speed and saves disk space since many grid elements are
   // zero.
-  bool is3d;
-  if (event.density_grid().shape()[2] == 1) is3d = false;
-  else is3d = true;
-
-
-  for (const auto& slice : event.density_grid()) {
-    for (const auto& row : slice) {
-      for (const auto& item : row) {
-		 ofs << item << " ";
-	  }
-	  if (is3d) ofs << std::endl;
+  // The rows are visited one at a time, so that a streamed density is never
+  // stored in full.
+  const auto shape = event.density_shape();
+  const auto nx = shape[1], neta = shape[2];
+  bool is3d = (neta != 1);
+
+  event.for_each_density_row(
+    [&ofs, nx, neta, is3d](int, const Event::GridElement* row) {
+      for (std::size_t ix = 0; ix < nx; ++ix) {
+        for (std::size_t ieta = 0; ieta < neta; ++ieta)
+          ofs << row[ix*neta + ieta] << " ";
+        if (is3d) ofs << std::endl;
+      }
+      if (!is3d) ofs << std::endl;
+    });
+
+  // Eta-dependent observables as lists over the slices.  They follow the grid,
+  // since a streamed density accumulates them while its rows are written.
+  if (header && event.has_eta_observables()) {
+    const auto& harmonics = event.harmonics();
+    auto write_list = [&ofs, neta](const std::string& key,
+                                   const double* values) {
+      ofs << "# " << key << " =";
+      for (std::size_t i = 0; i < neta; ++i)
+        ofs << ' ' << values[i];
+      ofs << '\n';
+    };
+    std::vector<double> eta(neta);
+    for (std::size_t i = 0; i < neta; ++i)
+      eta[i] = -event.etamax() + i*event.deta();
+    write_list("eta", eta.data());
+    write_list("dS/deta", event.eta_multiplicity().data());
+    for (std::size_t k = 0; k < harmonics.size(); ++k) {
+      const auto n = std::to_string(harmonics[k]);
+      write_list("e" + n + "(eta)", &event.eta_eccentricity()[k*neta]);
+      write_list("psi" + n + "(eta)", &event.eta_event_planes()[k*neta]);
+      write_list("r" + n + "(eta)", &event.eta_decorrelation()[k*neta]);
     }
-	if (!is3d) ofs << std::endl;
+  }
+
+  // Write the binary collision vertices to a separate file, one collision
+  // (x, y, b) per line.
+  if (event.has_collision_vertices()) {
+    std::ostringstream vertex_fname{};
+    vertex_fname << std::setw(width) << std::setfill('0') << num
+                 << "_collisions.txt";
+    fs::ofstream vfs{output_dir / vertex_fname.str()};
+    if (header)
+      vfs << "# x y b\n";
+    const auto& vertices = event.collision_vertices();
+    vfs << std::setprecision(10);
+    for (std::size_t i = 0; i < vertices.size(); i += 3)
+      vfs << vertices[i] << ' ' << vertices[i+1] << ' '
+          << vertices[i+2] << '\n';
   }
 }
 
@@ -123,14 +171,43 @@ void hdf5_add_scalar_attr(
   attr.write(datatype, &value);
 }
 
+// Add a one-dimensional dataset of doubles to an HDF5 file.
+void hdf5_add_array(const H5::H5File& file, const std::string& name,
+                    const double* data, std::size_t size) {
+  const auto& datatype = hdf5::type<double>();
+  std::array<hsize_t, 1> shape{{size}};
+  auto dataset = file.createDataSet(
+    name, datatype, hdf5::make_dataspace(shape));
+  dataset.write(data, datatype);
+}
+
 HDF5Writer::HDF5Writer(const fs::path& filename)
     : file_(filename.string(), H5F_ACC_TRUNC)
 {}
 
+// Release a held lock for the lifetime of the object, e.g. while computing
+// between library calls.  It is reacquired even if an exception is thrown, so
+// that the HDF5 objects still alive in the enclosing scope are closed under
+// the lock.
+class ScopedUnlock {
+ public:
+  explicit ScopedUnlock(std::unique_lock<std::mutex>& lock) : lock_(lock)
+  { lock_.unlock(); }
+  ~ScopedUnlock()
+  { lock_.lock(); }
+
+ private:
+  std::unique_lock<std::mutex>& lock_;
+};
+
 void HDF5Writer::operator()(
     int num, double impact_param, const Event& event) const {
-  const auto& grid1 = event.density_grid();
-  const auto& grid2 = event.TAB_grid();
+  // Events may be written concurrently by several threads, so the lock is held
+  // for all library calls, including the destructors of the HDF5 objects
+  // below, since it is declared first.
+  std::unique_lock<std::mutex> lock{hdf5::library_mutex()};
+
+  const auto shape1 = event.density_shape();
 
   // The dataset name is a prefix plus the event number.
   const std::string gp_name{"/event_" + std::to_string(num)};
@@ -146,56 +223,125 @@ void HDF5Writer::operator()(
   hdf5_add_scalar_attr(group, "mult", event.multiplicity());
   hdf5_add_scalar_attr(group, "dxy", event.dxy());
   hdf5_add_scalar_attr(group, "deta", event.deta());
-  hdf5_add_scalar_attr(group, "Ny", grid1.shape()[0]);
-  hdf5_add_scalar_attr(group, "Nx", grid1.shape()[1]);
-  hdf5_add_scalar_attr(group, "Nz", grid1.shape()[2]);
-  for (const auto& ecc : event.eccentricity())
-    hdf5_add_scalar_attr(group, "e" + std::to_string(ecc.first), ecc.second);
-  for (const auto& psi : event.event_planes())
-    hdf5_add_scalar_attr(group, "psi" + std::to_string(psi.first), psi.second);
+  hdf5_add_scalar_attr(group, "Ny", shape1[0]);
+  hdf5_add_scalar_attr(group, "Nx", shape1[1]);
+  hdf5_add_scalar_attr(group, "Nz", shape1[2]);
+  const auto& harmonics = event.harmonics();
+  for (std::size_t k = 0; k < harmonics.size(); ++k)
+    hdf5_add_scalar_attr(group, "e" + std::to_string(harmonics[k]),
+                         event.eccentricity()[k]);
+  for (std::size_t k = 0; k < harmonics.size(); ++k)
+    hdf5_add_scalar_attr(group, "psi" + std::to_string(harmonics[k]),
+                         event.event_planes()[k]);
 
   ////////////////////////////////////////////////////////////////////
   // Define HDF5 datatype and dataspace to match the density (3D) grid.
   
-  const auto& datatype1 = hdf5::type<Event::Grid3D::element>();
-  std::array<hsize_t, Event::Grid3D::dimensionality> shape1;
-  std::copy(grid1.shape(), grid1.shape() + shape1.size(), shape1.begin());
-  auto dataspace1 = hdf5::make_dataspace(shape1);
+  const auto& datatype1 = hdf5::type<Event::GridElement>();
+  std::array<hsize_t, Event::Grid3D::dimensionality> hshape1;
+  std::copy(shape1.begin(), shape1.end(), hshape1.begin());
+  auto dataspace1 = hdf5::make_dataspace(hshape1);
+
+  // A streamed density is written one row (fixed y) at a time as it is
+  // computed, so it is also chunked by rows; HDF5 would otherwise have to hold
+  // a chunk of the entire grid in memory.
+  std::array<hsize_t, Event::Grid3D::dimensionality> row_shape{
+    {1, hshape1[1], hshape1[2]}};
 
   // Set dataset storage properties.
   H5::DSetCreatPropList proplist1{};
-  // Set chunk size to the entire grid.  For typical grid sizes (~100x100), this
-  // works out to ~80 KiB, which is pretty optimal.  Anyway, it makes logical
-  // sense to chunk this way, since chunks must be read contiguously and there's
-  // no reason to read a partial grid.
-  proplist1.setChunk(shape1.size(), shape1.data());
+  // Otherwise set chunk size to the entire grid.  For typical grid sizes
+  // (~100x100), this works out to ~80 KiB, which is pretty optimal.  Anyway, it
+  // makes logical sense to chunk this way, since chunks must be read
+  // contiguously and there's no reason to read a partial grid.
+  if (event.streams_density())
+    proplist1.setChunk(row_shape.size(), row_shape.data());
+  else
+    proplist1.setChunk(hshape1.size(), hshape1.data());
   // Set gzip compression level.  4 is the default in h5py.
   proplist1.setDeflate(4);
 
-  // Create the new dataset and write the grid for matter density
-  auto dataset1 = file_.createDataSet(sd_name, datatype1, dataspace1, proplist1);
-  dataset1.write(grid1.data(), datatype1);
+  // Create the new dataset and write the grid for matter density, unless it
+  // is not output.
+  if (event.has_density()) {
+    auto dataset1 =
+      file_.createDataSet(sd_name, datatype1, dataspace1, proplist1);
+    if (event.streams_density()) {
+      // Compute the rows without the lock, so that other threads can write
+      // meanwhile, and only take it for writing each row.
+      auto memspace = hdf5::make_dataspace(row_shape);
+      ScopedUnlock unlock{lock};
+      event.for_each_density_row(
+        [&](int iy, const Event::GridElement* row) {
+          std::lock_guard<std::mutex> row_lock{hdf5::library_mutex()};
+          std::array<hsize_t, Event::Grid3D::dimensionality> offset{
+            {static_cast<hsize_t>(iy), 0, 0}};
+          dataspace1.selectHyperslab(
+            H5S_SELECT_SET, row_shape.data(), offset.data());
+          dataset1.write(row, datatype1, memspace, dataspace1);
+        });
+    } else {
+      dataset1.write(event.density_grid().data(), datatype1);
+    }
+  }
 
-  //////////////////////////////////////////////////////////////////
-  // Define HDF5 datatype and dataspace to match the Ncoll (2D) grid.
-  const auto& datatype2 = hdf5::type<Event::Grid::element>();
-  std::array<hsize_t, Event::Grid::dimensionality> shape2;
-  std::copy(grid2.shape(), grid2.shape() + shape2.size(), shape2.begin());
-  auto dataspace2 = hdf5::make_dataspace(shape2);
-  
-  // Set dataset storage properties.
-  H5::DSetCreatPropList proplist2{};
-  // Set chunk size to the entire grid.  For typical grid sizes (~100x100), this
-  // works out to ~80 KiB, which is pretty optimal.  Anyway, it makes logical
-  // sense to chunk this way, since chunks must be read contiguously and there's
-  // no reason to read a partial grid.
-  proplist1.setChunk(shape2.size(), shape2.data());
-  // Set gzip compression level.  4 is the default in h5py.
-  proplist1.setDeflate(4);
+  // Eta-dependent observables, one dataset per quantity and harmonic over the
+  // eta slices.
+  if (event.has_eta_observables()) {
+    const auto neta = event.eta_multiplicity().size();
+    std::vector<double> eta(neta);
+    for (std::size_t i = 0; i < neta; ++i)
+      eta[i] = -event.etamax() + i*event.deta();
+    hdf5_add_array(file_, gp_name + "/eta", eta.data(), neta);
+    hdf5_add_array(file_, gp_name + "/dS_deta",
+                   event.eta_multiplicity().data(), neta);
+    for (std::size_t k = 0; k < harmonics.size(); ++k) {
+      const auto n = std::to_string(harmonics[k]);
+      hdf5_add_array(file_, gp_name + "/e" + n + "_eta",
+                     &event.eta_eccentricity()[k*neta], neta);
+      hdf5_add_array(file_, gp_name + "/psi" + n + "_eta",
+                     &event.eta_event_planes()[k*neta], neta);
+      hdf5_add_array(file_, gp_name + "/r" + n + "_eta",
+                     &event.eta_decorrelation()[k*neta], neta);
+    }
+  }
 
-  // Create the new dataset and write the grid for matter density
-  auto dataset2 = file_.createDataSet(tab_name, datatype2, dataspace2, proplist2);
-  dataset2.write(grid2.data(), datatype2);
+  // Binary collision vertices as a table with one row (x, y, b) per
+  // collision.
+  if (event.has_collision_vertices()) {
+    const auto& vertices = event.collision_vertices();
+    const auto& datatype = hdf5::type<double>();
+    std::array<hsize_t, 2> shape{{vertices.size()/3, 3}};
+    auto dataset = file_.createDataSet(
+      gp_name + "/collisions", datatype, hdf5::make_dataspace(shape));
+    dataset.write(vertices.data(), datatype);
+  }
+
+  if (event.has_ncoll_density()) {
+    //////////////////////////////////////////////////////////////////
+    // Define HDF5 datatype and dataspace to match the Ncoll (2D) grid, if
+    // it is computed.
+    const auto& grid2 = event.TAB_grid();
+    const auto& datatype2 = hdf5::type<Event::Grid::element>();
+    std::array<hsize_t, Event::Grid::dimensionality> shape2;
+    std::copy(grid2.shape(), grid2.shape() + shape2.size(), shape2.begin());
+    auto dataspace2 = hdf5::make_dataspace(shape2);
+
+    // Set dataset storage properties.
+    H5::DSetCreatPropList proplist2{};
+    // Set chunk size to the entire grid.  For typical grid sizes (~100x100),
+    // this works out to ~80 KiB, which is pretty optimal.  Anyway, it makes
+    // logical sense to chunk this way, since chunks must be read contiguously
+    // and there's no reason to read a partial grid.
+    proplist2.setChunk(shape2.size(), shape2.data());
+    // Set gzip compression level.  4 is the default in h5py.
+    proplist2.setDeflate(4);
+
+    // Create the new dataset and write the grid for Ncoll density
+    auto dataset2 =
+      file_.createDataSet(tab_name, datatype2, dataspace2, proplist2);
+    dataset2.write(grid2.data(), datatype2);
+  }
 }
 
 #endif  // TRENTO_HDF5
@@ -211,7 +357,7 @@ Output::Output(const VarMap& var_map){
 
   // Write to stdout unless the quiet option was specified.
   if (!var_map["quiet"].as<bool>()) {
-    writers_.emplace_back(
+    stdout_writers_.emplace_back(
       [width](int num, double impact_param, const Event& event) {
         write_stream(std::cout, width, num, impact_param, event);
       }
@@ -226,7 +372,7 @@ Output::Output(const VarMap& var_map){
       if (fs::exists(output_path) && !fs::is_empty(output_path))
         throw std::runtime_error{"file '" + output_path.string() +
                                  "' exists, will not overwrite"};
-      writers_.emplace_back(HDF5Writer{output_path});
+      file_writers_.emplace_back(HDF5Writer{output_path});
 #else
       throw std::runtime_error{"HDF5 output was not compiled"};
 #endif  // TRENTO_HDF5
@@ -244,7 +390,7 @@ Output::Output(const VarMap& var_map){
         fs::create_directories(output_path);
       }
       auto header = !var_map["no-header"].as<bool>();
-      writers_.emplace_back(
+      file_writers_.emplace_back(
         [output_path, width, header](
             int num, double impact_param, const Event& event) {
           write_text_file(output_path, width, num, impact_param, event, header);
@@ -29,19 +29,49 @@ class Output {
   /// - ``double`` impact parameter
   /// - ``const Event&`` Event object
   ///
+  /// This is equivalent to ``write_files()`` followed by ``write_stdout()``.
   /// \endrst
   template <typename... Args>
   void operator()(Args&&... args) const;
 
+  /// \rst
+  /// Write the event to the text or HDF5 output, if any.  May be called
+  /// concurrently for different events (and Event objects) in any order: text
+  /// files are separate per event, and HDF5 groups are named by event number
+  /// and written under ``hdf5::library_mutex()``, which is only held while
+  /// calling the library, not e.g. while a streamed density is computed.
+  /// \endrst
+  template <typename... Args>
+  void write_files(Args&&... args) const;
+
+  /// Write the event properties to stdout, unless quiet.  Calls must not
+  /// overlap and are written in the order made, so they should be in order of
+  /// event number.
+  template <typename... Args>
+  void write_stdout(Args&&... args) const;
+
  private:
-  /// Internal storage of output functions.
-  std::vector<std::function<void(int, double, const Event&)>> writers_;
+  /// Internal storage of output functions, for files and stdout.
+  using Writer = std::function<void(int, double, const Event&)>;
+  std::vector<Writer> file_writers_, stdout_writers_;
 };
 
 template <typename... Args>
 void Output::operator()(Args&&... args) const {
-  for (const auto& write : writers_)
-    write(std::forward<Args>(args)...);
+  write_files(args...);
+  write_stdout(std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+void Output::write_files(Args&&... args) const {
+  for (const auto& write : file_writers_)
+    write(args...);
+}
+
+template <typename... Args>
+void Output::write_stdout(Args&&... args) const {
+  for (const auto& write : stdout_writers_)
+    write(args...);
 }
 
 }  // namespace trento
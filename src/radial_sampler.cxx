@@ -0,0 +1,142 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#include "radial_sampler.h"
+
+#include <stdexcept>
+
+#include "fast_math.h"
+#include "random.h"
+
+namespace trento {
+
+constexpr double RadialSampler::edge_bins;
+
+namespace {
+
+// Number of integration steps of the CDF per table bin.
+constexpr std::size_t steps_per_bin = 64;
+
+// Number of values evaluated at once by RadialSampler::invert().
+constexpr std::size_t invert_block = 64;
+
+}  // unnamed namespace
+
+RadialSampler::RadialSampler(const std::function<double(double)>& density,
+                             double rmax, std::size_t nbins)
+    : nbins_(static_cast<double>(nbins)),
+      edge_scale_(nbins_/edge_bins),
+      coeffs_(9*nbins) {
+  // The subdivided head and tail tables must not overlap.
+  if (static_cast<double>(nbins) < 2.*edge_bins)
+    throw std::invalid_argument{"radial sampler needs at least 8 bins"};
+  if (!(rmax > 0.))
+    throw std::invalid_argument{"radial sampler needs a positive range"};
+
+  // Integrate the CDF on a fine grid by Simpson's rule.
+  const auto nsteps = steps_per_bin*nbins;
+  const auto h = rmax/static_cast<double>(nsteps);
+  std::vector<double> cdf(nsteps + 1);
+  cdf[0] = 0.;
+  auto f_lo = density(0.);
+  for (std::size_t j = 0; j < nsteps; ++j) {
+    const auto r = static_cast<double>(j)*h;
+    const auto f_hi = density(r + h);
+    cdf[j+1] = cdf[j] + h/6.*(f_lo + 4.*density(r + .5*h) + f_hi);
+    f_lo = f_hi;
+  }
+  if (!(cdf[nsteps] > 0.))
+    throw std::invalid_argument{"radial sampler density must be positive"};
+
+  // Invert it by linear interpolation on the fine grid, at increasing
+  // probabilities, so one walk along the grid finds them all.
+  auto inverse_cdf = [&cdf, nsteps, h](const std::vector<double>& probs) {
+    std::vector<double> r(probs.size());
+    std::size_t j = 0;
+    for (std::size_t i = 0; i < probs.size(); ++i) {
+      const auto target = cdf[nsteps]*probs[i];
+      while (j < nsteps - 1 && cdf[j+1] <= target)
+        ++j;
+      const auto dF = cdf[j+1] - cdf[j];
+      const auto t = dF > 0. ? std::min(std::max((target - cdf[j])/dF, 0.), 1.)
+                             : 0.;
+      r[i] = (static_cast<double>(j) + t)*h;
+    }
+    return r;
+  };
+
+  // Quadratic through the inverse CDF at the edges and midpoints of bins of
+  // probability width p starting at p0.  It is increasing on a bin if its
+  // slope is non-negative at both edges, i.e. if |c2| <= r1 - r0; otherwise
+  // clamp c2, keeping the edges, so that the inverse CDF stays monotonic.
+  auto fit_bins = [&inverse_cdf, nbins](double p0, double p, double* coeffs) {
+    std::vector<double> probs(2*nbins + 1);
+    for (std::size_t i = 0; i < probs.size(); ++i)
+      probs[i] = std::min(p0 + .5*p*static_cast<double>(i), 1.);
+    const auto knots = inverse_cdf(probs);
+    for (std::size_t k = 0; k < nbins; ++k) {
+      const auto r0 = knots[2*k], rm = knots[2*k+1], r1 = knots[2*k+2];
+      const auto c2 = std::min(std::max(2.*(r0 + r1) - 4.*rm, r0 - r1),
+                               r1 - r0);
+      coeffs[3*k] = r0;
+      coeffs[3*k+1] = r1 - r0 - c2;
+      coeffs[3*k+2] = c2;
+    }
+  };
+
+  // The main table, followed by the first and the last edge_bins bins each
+  // subdivided into nbins bins.  Near zero, a density with the usual r^2
+  // Jacobian has an inverse CDF ~ u^(1/3), and an exponential tail has one
+  // ~ -log(1 - u) up to the cutoff, which quadratics fit poorly on the
+  // outermost bins.
+  const auto edge_width = edge_bins/nbins_;
+  fit_bins(0., 1./nbins_, &coeffs_[0]);
+  fit_bins(0., edge_width/nbins_, &coeffs_[3*nbins]);
+  fit_bins(1. - edge_width, edge_width/nbins_, &coeffs_[6*nbins]);
+}
+
+void RadialSampler::invert(double* u, std::size_t n) const {
+  // Evaluate blocks into a local array, which cannot alias the table, so
+  // that the loop vectorizes with gathers from the table.
+  const auto* coeffs = coeffs_.data();
+  const auto nbins = nbins_, edge_scale = edge_scale_;
+  double r[invert_block];
+  for (std::size_t start = 0; start < n; start += invert_block) {
+    const auto m = std::min(invert_block, n - start);
+    for (std::size_t i = 0; i < m; ++i)
+      r[i] = evaluate(coeffs, nbins, edge_scale, u[start + i]);
+    std::copy(r, r + m, u + start);
+  }
+}
+
+void RadialSampler::sample(double* r, std::size_t n) const {
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = random::canonical<double>();
+  invert(r, n);
+}
+
+void RadialSampler::sample_sorted(double* r, std::size_t n) const {
+  // The order statistics of n uniform numbers are the partial sums of n + 1
+  // standard exponential numbers, divided by the total.
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = random::canonical<double>();
+  const auto last = -fast_log(1. - random::canonical<double>());
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] = -fast_log(1. - r[i]);
+
+  auto sum = 0.;
+  for (std::size_t i = 0; i < n; ++i) {
+    sum += r[i];
+    r[i] = sum;
+  }
+
+  const auto scale = 1./(sum + last);
+  for (std::size_t i = 0; i < n; ++i)
+    r[i] *= scale;
+
+  invert(r, n);
+}
+
+}  // namespace trento
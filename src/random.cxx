@@ -7,7 +7,20 @@
 
 namespace trento { namespace random {
 
+namespace {
+
+// Draw a full 64-bit key from the hardware device.
+Engine::result_type device_seed() {
+  std::random_device device{};
+  auto hi = static_cast<Engine::result_type>(device());
+  auto lo = static_cast<Engine::result_type>(device());
+  return (hi << 32) | lo;
+}
+
+}  // unnamed namespace
+
 // Seed random number generator from hardware device.
-Engine engine{std::random_device{}()};
+// Every thread is seeded separately when it first uses the engine.
+thread_local Engine engine{device_seed()};
 
 }}  // namespace trento::random
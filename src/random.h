@@ -6,6 +6,8 @@
 #ifndef RANDOM_H
 #define RANDOM_H
 
+#include <array>
+#include <cstdint>
 #include <limits>
 #include <random>
 
@@ -15,11 +17,88 @@
 
 namespace trento { namespace random {
 
-/// Mersenne Twister engine, 64-bit preset.
-using Engine = std::mt19937_64;
+/// \rst
+/// Counter-based random number engine implementing the Philox4x32-10
+/// generator of Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"
+/// (http://dx.doi.org/10.1145/2063384.2063405).  Satisfies the standard
+/// UniformRandomBitGenerator requirements, so it works with the ``<random>``
+/// distributions.
+///
+/// Output is a pure function of a 64-bit key (the seed) and a 128-bit counter.
+/// The counter is split into an event index, a try index, a stream index and a
+/// block index which advances as numbers are drawn.  Calling ``seek()``
+/// positions the engine at the start of any (event, try) stream without
+/// generating the preceding ones, so every event can be regenerated
+/// independently of all others, and the output does not depend on the order
+/// in which events are generated.
+///
+/// Example::
+///
+///   Philox engine{seed};
+///   engine.seek(event_number, try_number);
+///   double u = std::generate_canonical<double, 53>(engine);
+///
+/// \endrst
+class Philox {
+ public:
+  using result_type = std::uint64_t;
 
-/// Global variable defined in \c random.cxx.
-extern Engine engine;
+  /// Smallest possible output.
+  static constexpr result_type min()
+  { return std::numeric_limits<result_type>::min(); }
+
+  /// Largest possible output.
+  static constexpr result_type max()
+  { return std::numeric_limits<result_type>::max(); }
+
+  /// Construct with the given key and a zero counter.
+  explicit Philox(result_type seed = 0)
+  { this->seed(seed); }
+
+  /// Set the key and reset the counter to zero.
+  void seed(result_type seed);
+
+  /// Position the engine at the first number of the given stream.  Streams
+  /// with different (event, trial, stream) indices never overlap.
+  void seek(std::uint32_t event, std::uint32_t trial, std::uint32_t stream = 0);
+
+  /// Event index of the current stream.
+  std::uint32_t event() const;
+
+  /// Generate the next number.
+  result_type operator()();
+
+  /// Advance the engine by z numbers.
+  void discard(unsigned long long z);
+
+  /// Apply the Philox4x32-10 bijection to a counter with the given key.
+  static std::array<std::uint32_t, 4> bijection(
+      std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key);
+
+ private:
+  /// Encrypt the current counter into the output buffer and increment the
+  /// block index.
+  void generate();
+
+  /// Key (from the seed).
+  std::array<std::uint32_t, 2> key_;
+
+  /// Counter words: block index, try index, event index, stream index.
+  std::array<std::uint32_t, 4> counter_;
+
+  /// The most recently generated block, consumed two words at a time.
+  std::array<std::uint32_t, 4> buffer_;
+
+  /// Number of 64-bit values already consumed from the buffer.
+  std::size_t consumed_;
+};
+
+/// Engine type used throughout the program.
+using Engine = Philox;
+
+/// Global variable defined in \c random.cxx.  Each thread has its own
+/// instance, so event generation threads draw from independent streams.
+extern thread_local Engine engine;
 
 /// Helper function to easily generate random numbers in [0, 1).
 template <typename RealType = double>
@@ -41,6 +120,71 @@ inline double phi() {
   return math::constants::two_pi<RealType>() * canonical<RealType>();
 }
 
+// Philox inline member functions
+
+inline void Philox::seed(result_type seed) {
+  key_ = {{static_cast<std::uint32_t>(seed),
+           static_cast<std::uint32_t>(seed >> 32)}};
+  seek(0, 0);
+}
+
+inline void Philox::seek(
+    std::uint32_t event, std::uint32_t trial, std::uint32_t stream) {
+  counter_ = {{0, trial, event, stream}};
+  consumed_ = 2;
+}
+
+inline std::uint32_t Philox::event() const {
+  return counter_[2];
+}
+
+inline std::array<std::uint32_t, 4> Philox::bijection(
+    std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key) {
+  // Multipliers and Weyl sequence key increments from the reference
+  // implementation.
+  constexpr std::uint64_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+  constexpr std::uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+  for (int round = 0; round < 10; ++round) {
+    if (round > 0) {
+      key[0] += W0;
+      key[1] += W1;
+    }
+    auto p0 = M0 * counter[0];
+    auto p1 = M1 * counter[2];
+    counter = {{
+      static_cast<std::uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+      static_cast<std::uint32_t>(p1),
+      static_cast<std::uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+      static_cast<std::uint32_t>(p0)
+    }};
+  }
+
+  return counter;
+}
+
+inline void Philox::generate() {
+  buffer_ = bijection(counter_, key_);
+  // The block index wraps after 2^32 blocks, i.e. 2^33 numbers per stream;
+  // far more than any single try consumes.
+  ++counter_[0];
+  consumed_ = 0;
+}
+
+inline Philox::result_type Philox::operator()() {
+  if (consumed_ == 2)
+    generate();
+  auto lo = static_cast<result_type>(buffer_[2*consumed_]);
+  auto hi = static_cast<result_type>(buffer_[2*consumed_ + 1]);
+  ++consumed_;
+  return (hi << 32) | lo;
+}
+
+inline void Philox::discard(unsigned long long z) {
+  for (; z > 0; --z)
+    (*this)();
+}
+
 }}  // namespace trento::random
 
 #endif  // RANDOM_H
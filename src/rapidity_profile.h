@@ -6,6 +6,7 @@
 #ifndef ETA_H
 #define ETA_H
 
+#include <algorithm>
 #include <cmath>
 #include <vector>
 #include <gsl/gsl_fft_complex.h>
@@ -87,6 +88,17 @@ public:
     return dydeta_[index]*(1. - xi) + dydeta_[index+1]*xi;
   }
 
+  /// The tabulated rapidity and Jacobian at eta = -etamax + i*deta, i.e. a
+  /// plan for a pseudorapidity grid with the same range and step, which needs
+  /// no interpolation.
+  const std::vector<double>& rapidity_plan() const {
+    return y_;
+  }
+
+  const std::vector<double>& Jacobian_plan() const {
+    return dydeta_;
+  }
+
 };
 
 
@@ -100,6 +112,13 @@ public:
 /// oscillations at large rapidity and leaves the details close to mid-rapidity 
 /// unchanged. We used GSL FFT library (more specialized library would be FFTW, 
 /// e.g.), with 256 points. The transformed results are stored and interpolated. 
+///
+/// The transformed array does not depend on the mean (a shift) nor on the
+/// std (which only scales the rapidity range), only on the skew.  Hence the
+/// shapes can be tabulated once over a range of skew values by tabulate(),
+/// after which calculate_dsdy() just selects the two neighbouring shapes and
+/// interp_dsdy() interpolates linearly in both skew and rapidity.  Skew values
+/// outside the table fall back to the FFT.
 class cumulant_generating{
 private:
   size_t const N;
@@ -108,20 +127,22 @@ private:
   double deta;
   double center;
 
-public:
-  cumulant_generating(): N(256), data(new double[2*N]), dsdy(new double[2*N]){};
+  /// Tabulated shapes, N values for each of nskew equally spaced skew values
+  /// from -skew_max to skew_max.
+  std::vector<double> table;
+  double skew_max, dskew;
 
-  /// This function set the mean, std and skew of the profile and use FFT to
-  /// transform cumulant generating function at zero mean.
-  void calculate_dsdy(double mean, double std, double skew){
+  /// The two shapes interp_dsdy() interpolates between, and the weight of the
+  /// second; both point to dsdy after an exact calculation.
+  const double * lower, * upper;
+  double upper_weight;
+
+  /// Transform the cumulant generating function for the given skew into out.
+  void transform(double skew, double * out){
     double k1, k2, k3, amp, arg;
-    // adaptive eta_max = 3.33*std;
-    center = mean;
-    eta_max = std*3.33;
-    deta = 2.*eta_max/(N-1.);
-    double fftmean = eta_max/std;
+    double fftmean = 3.33;
       for(size_t i=0;i<N;i++){
-          k1 = M_PI*(i-N/2.0)/eta_max*std;
+          k1 = M_PI*(i-N/2.0)/fftmean;
       k2 = k1*k1;
       k3 = k2*k1;
 
@@ -134,10 +155,46 @@ public:
        gsl_fft_complex_radix2_forward(data, 1, N);
 
       for(size_t i=0;i<N;i++){
-          dsdy[i] = REAL(data,i)*(2.0*static_cast<double>(i%2 == 0)-1.0);
+          out[i] = REAL(data,i)*(2.0*static_cast<double>(i%2 == 0)-1.0);
       }
   }
 
+public:
+  cumulant_generating(): N(256), data(new double[2*N]), dsdy(new double[2*N]),
+      skew_max(-1.), dskew(0.), lower(dsdy), upper(dsdy), upper_weight(0.){};
+
+  /// Tabulate the shapes at nskew (at least two) skew values spanning
+  /// [-max_skew, max_skew].  Linear interpolation in the skew is then
+  /// accurate to O((2*max_skew/nskew)^2).
+  void tabulate(double max_skew, size_t nskew){
+    skew_max = std::max(max_skew, TINY);
+    dskew = 2.*skew_max/(nskew - 1.);
+    table.resize(nskew*N);
+    for(size_t i=0;i<nskew;i++)
+      transform(-skew_max + i*dskew, table.data() + i*N);
+  }
+
+  /// This function set the mean, std and skew of the profile and use FFT to
+  /// transform cumulant generating function at zero mean, or looks up the
+  /// shape if it has been tabulated for this skew.
+  void calculate_dsdy(double mean, double std, double skew){
+    // adaptive eta_max = 3.33*std;
+    center = mean;
+    eta_max = std*3.33;
+    deta = 2.*eta_max/(N-1.);
+    if (std::fabs(skew) <= skew_max){
+      double xs = (skew + skew_max)/dskew;
+      size_t is = std::min(static_cast<size_t>(xs), table.size()/N - 2);
+      lower = table.data() + is*N;
+      upper = lower + N;
+      upper_weight = xs - is;
+    } else {
+      transform(skew, dsdy);
+      lower = upper = dsdy;
+      upper_weight = 0.;
+    }
+  }
+
   /// When interpolating the funtion, the mean is put back by simply shifting 
   /// the function by y = y - mean + dy/2, the last term is correcting for
   /// interpolating bin edge instead of bin center
@@ -147,7 +204,31 @@ public:
     double xy = (y+eta_max)/deta;
     size_t iy = std::floor(xy);
     double ry = xy-iy;
-    return dsdy[iy]*(1.-ry) + dsdy[iy+1]*ry;
+    double lo = lower[iy]*(1.-ry) + lower[iy+1]*ry;
+    double hi = upper[iy]*(1.-ry) + upper[iy+1]*ry;
+    return lo + upper_weight*(hi - lo);
+  }
+
+  /// Batched version of the above for n rapidities:
+  /// out[i] = scale*weight[i]*interp_dsdy(y[i]).  Out-of-range values are
+  /// masked instead of branched on, so the loop vectorizes.  The output may
+  /// be single precision (see Event::GridElement).
+  template <typename T>
+  void interp_dsdy(const double * y, size_t n, const double * weight,
+                   double scale, T * out) const {
+    const double offset = -center + deta/2. + eta_max;
+    const double inv_deta = 1./deta;
+    const double xmax = N - 1.;
+    const double w = upper_weight;
+    for(size_t i=0;i<n;i++){
+      double xy = (y[i] + offset)*inv_deta;
+      double inside = static_cast<double>((xy >= 0.) & (xy < xmax));
+      size_t iy = std::min(static_cast<size_t>(std::max(xy, 0.)), N - 2);
+      double ry = xy - iy;
+      double lo = lower[iy]*(1.-ry) + lower[iy+1]*ry;
+      double hi = upper[iy]*(1.-ry) + upper[iy+1]*ry;
+      out[i] = static_cast<T>(inside*scale*weight[i]*(lo + w*(hi - lo)));
+    }
   }
 };
 #endif
@@ -113,7 +113,13 @@ int main(int argc, char* argv[]) {
     ("bibtex", "print bibtex entry and exit")
     // ("default-config", "print a config file with default settings and exit")
     ("config-file,c", po::value<VecPath>()->value_name("FILE"),
-     "configuration file\n(can be passed multiple times)");
+     "configuration file\n(can be passed multiple times)")
+    ("threads",
+     po::value<int>()->value_name("INT")->default_value(1, "1"),
+     "number of event generation threads\n(0 = one per hardware core)")
+    ("config-cache",
+     po::value<int>()->value_name("INT")->default_value(1024, "1024"),
+     "memory for nuclear configurations read from HDF5 files [MiB]");
 
   OptDesc output_opts{"output options"};
   output_opts.add_options()
@@ -122,7 +128,24 @@ int main(int argc, char* argv[]) {
     ("output,o", po::value<fs::path>()->value_name("PATH"),
      "HDF5 file or directory for text files")
     ("no-header", po::bool_switch(),
-     "do not write headers to text files");
+     "do not write headers to text files")
+    ("stats", po::bool_switch(),
+     "print run statistics to stderr")
+    ("stream-density", po::bool_switch(),
+     "compute the 3D density while writing it, one row at a time, instead of "
+     "storing the whole grid")
+    ("no-density", po::bool_switch(),
+     "do not output the density grid (only event properties)")
+    ("collision-vertices", po::bool_switch(),
+     "output the midpoint and impact parameter of each binary collision")
+    ("eta-observables", po::bool_switch(),
+     "compute and output dS/deta and eccentricities per eta slice (3D only)")
+    ("harmonics",
+     po::value<std::string>()->value_name("LIST")->default_value("2-5"),
+     "eccentricity harmonics to compute, e.g. 2-5 or 1,2,4-8")
+    ("radial-weight",
+     po::value<int>()->value_name("INT")->default_value(-1, "n"),
+     "power m of the eccentricity weight r^m (negative for r^n)");
 
   OptDesc phys_opts{"physical options"};
   phys_opts.add_options()
@@ -138,6 +161,10 @@ int main(int argc, char* argv[]) {
     ("nucleon-min-dist,d",
      po::value<double>()->value_name("FLOAT")->default_value(0., "0"),
      "minimum nucleon-nucleon distance [fm]")
+    ("nucleus-pool",
+     po::value<int>()->value_name("INT")->default_value(0, "off"),
+     "sample nuclei from a pool of this many pre-sampled configurations, "
+     "randomly rotated")
     ("mean-coeff,m",
      po::value<double>()->value_name("FLOAT")->default_value(1., "1."),
      "rapidity mean coefficient")
@@ -150,6 +177,9 @@ int main(int argc, char* argv[]) {
 	 ("skew-type,r",
       po::value<int>()->value_name("INT")->default_value(1, "1"),
       "rapidity skew type: 1: relative, 2: absolute, other: no skew")
+    ("exact-rapidity", po::bool_switch(),
+     "compute the rapidity profile of every cell by FFT instead of "
+     "interpolating tabulated shapes (for validation)")
     ("jacobian,j",
      po::value<double>()->value_name("FLOAT")->default_value(0.8, "0.8"),
      "<pt>/<mt> used in Jacobian")
@@ -186,6 +216,9 @@ int main(int argc, char* argv[]) {
     ("random-seed",
      po::value<int64_t>()->value_name("INT")->default_value(-1, "auto"),
      "random seed")
+    ("first-event",
+     po::value<int>()->value_name("INT")->default_value(0, "0"),
+     "number of the first event\n(to regenerate or shard a seeded run)")
     ("ncoll,b", po::bool_switch(),
      "calculate # of binary collision and binary collision density");
 
@@ -202,7 +235,11 @@ int main(int argc, char* argv[]) {
      "pseudorapidity max \n(eta grid from -max to +max)")
     ("eta-step",
      po::value<double>()->value_name("FLOAT")->default_value(0.5, "0.5"),
-     "pseudorapidity step size");
+     "pseudorapidity step size")
+    ("deposition",
+     po::value<std::string>()->value_name("KERNEL")
+     ->default_value("separable"),
+     "nucleon thickness deposition kernel\n(direct, separable, stamp, fft)");
 
   // Make a meta-group containing all the option groups except the main
   // positional options (don't want the auto-generated usage info for those).
@@ -0,0 +1,69 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#include "../src/cell_list.h"
+
+#include <cmath>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../src/nucleus.h"
+
+using namespace trento;
+
+TEST_CASE( "cell list" ) {
+  auto nucleus = Nucleus::create("Pb", 0.5);
+  nucleus->sample_nucleons(1.3);
+
+  const auto size = static_cast<std::size_t>(
+    std::distance(nucleus->begin(), nucleus->end()));
+  const double dmax = 2.1;
+
+  CellList cells{dmax};
+  cells.build(*nucleus);
+
+  // Every nucleon is visited at most once per query, and every nucleon within
+  // dmax of the query point is visited.
+  bool all_found = true, no_repeats = true, count_correct = true;
+  for (double x = -9.; x <= 12.; x += 0.7) {
+    for (double y = -10.; y <= 10.; y += 0.9) {
+      std::vector<std::size_t> visits(size, 0);
+      auto count = cells.for_each_neighbor(x, y,
+        [&visits](std::size_t i) { ++visits[i]; });
+
+      std::size_t nvisits = 0;
+      auto nucleon = nucleus->cbegin();
+      for (std::size_t i = 0; i < size; ++i, ++nucleon) {
+        nvisits += visits[i];
+        if (visits[i] > 1)
+          no_repeats = false;
+        auto dx = nucleon->x() - x;
+        auto dy = nucleon->y() - y;
+        if (dx*dx + dy*dy < dmax*dmax && visits[i] == 0)
+          all_found = false;
+      }
+      if (nvisits != count)
+        count_correct = false;
+    }
+  }
+
+  CHECK( all_found );
+  CHECK( no_repeats );
+  CHECK( count_correct );
+
+  // The sorted positions are copies of the nucleon positions.
+  bool positions_match = true;
+  for (std::size_t i = 0; i < size; ++i) {
+    auto j = cells.index()[i];
+    if (cells.x()[i] != nucleus->x_data()[j] ||
+        cells.y()[i] != nucleus->y_data()[j])
+      positions_match = false;
+  }
+  CHECK( positions_match );
+
+  // A point far away from the nucleus has no neighbors.
+  CHECK( cells.for_each_neighbor(100., 0., [](std::size_t) {}) == 0 );
+}
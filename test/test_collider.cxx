@@ -18,19 +18,45 @@ TEST_CASE( "collider" ) {
 
   auto var_map = make_var_map({
     {"number-events", N},
+    {"first-event", 0},
+    {"threads", 1},
     {"quiet", false},
     {"random-seed", static_cast<int64_t>(-1)},
     {"projectile", std::vector<std::string>{"Pb", "Pb"}},
     {"b-min", 0.},
     {"b-max", -1.},
+    {"npart-min", 0},
+    {"npart-max", std::numeric_limits<int>::max()},
+    {"s-min", 0.},
+    {"s-max", std::numeric_limits<double>::max()},
     {"normalization", 1.},
     {"reduced-thickness", 0.},
-    {"grid-max", 9.},
-    {"grid-step", 0.3},
+    {"beam-energy", 2760.},
+    {"mean-coeff", 1.},
+    {"std-coeff", 3.},
+    {"skew-coeff", 0.},
+    {"skew-type", 1},
+    {"exact-rapidity", false},
+    {"jacobian", 0.8},
+    {"xy-max", 9.},
+    {"xy-step", 0.3},
+    {"eta-max", 0.},
+    {"eta-step", 0.5},
+    {"deposition", std::string{"separable"}},
     {"fluctuation", 1.},
     {"cross-section", 6.4},
     {"nucleon-width", 0.5},
     {"nucleon-min-dist", 0.},
+    {"nucleus-pool", 0},
+    {"config-cache", 1024},
+    {"ncoll", false},
+    {"collision-vertices", false},
+    {"stats", false},
+    {"stream-density", false},
+    {"no-density", false},
+    {"eta-observables", false},
+    {"harmonics", std::string{"2-5"}},
+    {"radial-weight", -1},
   });
 
   std::vector<int> nevent, npart;
@@ -62,7 +88,7 @@ TEST_CASE( "collider" ) {
   CHECK( nevent == sequence );
 
   // verify impact parameters are within min-bias range
-  auto impact_max = 2*Nucleus::create("Pb")->radius() + 6*.5;
+  auto impact_max = 2*Nucleus::create("Pb", .5)->radius() + 6*.5;
   CHECK( impact >= std::vector<double>(N, 0.) );
   CHECK( impact <= std::vector<double>(N, impact_max) );
 
@@ -80,19 +106,45 @@ TEST_CASE( "fixed impact parameter" ) {
 
   auto var_map = make_var_map({
     {"number-events", N},
+    {"first-event", 0},
+    {"threads", 1},
     {"quiet", false},
     {"random-seed", static_cast<int64_t>(-1)},
     {"projectile", std::vector<std::string>{"Au", "Au"}},
     {"b-min", bfixed},
     {"b-max", bfixed},
+    {"npart-min", 0},
+    {"npart-max", std::numeric_limits<int>::max()},
+    {"s-min", 0.},
+    {"s-max", std::numeric_limits<double>::max()},
     {"normalization", 1.},
     {"reduced-thickness", 0.},
-    {"grid-max", 9.},
-    {"grid-step", 0.3},
+    {"beam-energy", 2760.},
+    {"mean-coeff", 1.},
+    {"std-coeff", 3.},
+    {"skew-coeff", 0.},
+    {"skew-type", 1},
+    {"exact-rapidity", false},
+    {"jacobian", 0.8},
+    {"xy-max", 9.},
+    {"xy-step", 0.3},
+    {"eta-max", 0.},
+    {"eta-step", 0.5},
+    {"deposition", std::string{"separable"}},
     {"fluctuation", 1.},
     {"cross-section", 6.4},
     {"nucleon-width", 0.5},
     {"nucleon-min-dist", 0.2},
+    {"nucleus-pool", 0},
+    {"config-cache", 1024},
+    {"ncoll", false},
+    {"collision-vertices", false},
+    {"stats", false},
+    {"stream-density", false},
+    {"no-density", false},
+    {"eta-observables", false},
+    {"harmonics", std::string{"2-5"}},
+    {"radial-weight", -1},
   });
 
   std::vector<double> impact;
@@ -126,19 +178,45 @@ TEST_CASE( "random seed" ) {
     [&seed]() {
       Collider collider{make_var_map({
         {"number-events", 3},
+        {"first-event", 0},
+        {"threads", 1},
         {"quiet", false},
         {"random-seed", seed},
         {"projectile", std::vector<std::string>{"p", "U"}},
         {"b-min", 0.},
         {"b-max", -1.},
+        {"npart-min", 0},
+        {"npart-max", std::numeric_limits<int>::max()},
+        {"s-min", 0.},
+        {"s-max", std::numeric_limits<double>::max()},
         {"normalization", 1.},
         {"reduced-thickness", 0.},
-        {"grid-max", 9.},
-        {"grid-step", 0.3},
+        {"beam-energy", 2760.},
+        {"mean-coeff", 1.},
+        {"std-coeff", 3.},
+        {"skew-coeff", 0.},
+        {"skew-type", 1},
+        {"exact-rapidity", false},
+        {"jacobian", 0.8},
+        {"xy-max", 9.},
+        {"xy-step", 0.3},
+        {"eta-max", 0.},
+        {"eta-step", 0.5},
+        {"deposition", std::string{"separable"}},
         {"fluctuation", 1.},
         {"cross-section", 6.4},
         {"nucleon-width", 0.5},
         {"nucleon-min-dist", 0.4},
+        {"nucleus-pool", 0},
+        {"config-cache", 1024},
+        {"ncoll", false},
+        {"collision-vertices", false},
+        {"stats", false},
+        {"stream-density", false},
+        {"no-density", false},
+        {"eta-observables", false},
+        {"harmonics", std::string{"2-5"}},
+        {"radial-weight", -1},
       })};
 
       capture_stdout capture;
@@ -151,3 +229,97 @@ TEST_CASE( "random seed" ) {
   CHECK( std::all_of(output.cbegin(), output.cend(),
     [&output](const std::string& s) { return s == output.front(); }) );
 }
+
+TEST_CASE( "threads" ) {
+  constexpr auto N = 12;
+
+  const auto seed = static_cast<int64_t>(std::random_device{}() + 1);
+
+  auto run = [&seed](int nthreads, int first, int nevents, int pool) {
+    Collider collider{make_var_map({
+      {"number-events", nevents},
+      {"first-event", first},
+      {"threads", nthreads},
+      {"quiet", false},
+      {"random-seed", seed},
+      {"projectile", std::vector<std::string>{"p", "Pb"}},
+      {"b-min", 0.},
+      {"b-max", -1.},
+      {"npart-min", 0},
+      {"npart-max", std::numeric_limits<int>::max()},
+      {"s-min", 0.},
+      {"s-max", std::numeric_limits<double>::max()},
+      {"normalization", 1.},
+      {"reduced-thickness", 0.},
+      {"beam-energy", 2760.},
+      {"mean-coeff", 1.},
+      {"std-coeff", 3.},
+      {"skew-coeff", 0.},
+      {"skew-type", 1},
+      {"exact-rapidity", false},
+      {"jacobian", 0.8},
+      {"xy-max", 9.},
+      {"xy-step", 0.3},
+      {"eta-max", 0.},
+      {"eta-step", 0.5},
+      {"deposition", std::string{"separable"}},
+      {"fluctuation", 1.},
+      {"cross-section", 6.4},
+      {"nucleon-width", 0.5},
+      {"nucleon-min-dist", 0.},
+      {"nucleus-pool", pool},
+      {"config-cache", 1024},
+      {"ncoll", false},
+      {"collision-vertices", false},
+      {"stats", false},
+      {"stream-density", false},
+      {"no-density", false},
+      {"eta-observables", false},
+      {"harmonics", std::string{"2-5"}},
+      {"radial-weight", -1},
+    })};
+
+    capture_stdout capture;
+    collider.run_events();
+
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(capture.stream, line))
+      lines.push_back(line);
+    return lines;
+  };
+
+  auto serial = run(1, 0, N, 0);
+
+  // events are written in order
+  std::vector<int> nevent;
+  for (const auto& line : serial) {
+    nevent.push_back(-1);
+    std::istringstream(line) >> nevent.back();
+  }
+  std::vector<int> sequence(N);
+  std::iota(sequence.begin(), sequence.end(), 0);
+  CHECK( nevent == sequence );
+
+  // and are identical regardless of the number of threads
+  CHECK( run(3, 0, N, 0) == serial );
+  CHECK( run(N + 2, 0, N, 0) == serial );
+
+  // any event can be regenerated on its own (compare everything after the
+  // event number, since the padding depends on the number of events)
+  auto strip_number = [](const std::string& line) {
+    std::istringstream iss{line};
+    int num;
+    iss >> num;
+    return std::make_pair(num, line.substr(static_cast<std::size_t>(iss.tellg())));
+  };
+  auto single = run(1, N/2, 1, 0);
+  REQUIRE( single.size() == 1 );
+  CHECK( strip_number(single.front()) == strip_number(serial[N/2]) );
+
+  // nucleus pools are sampled in parallel, also independently of the number
+  // of threads
+  auto pooled = run(1, 0, N, 20);
+  CHECK( pooled != serial );
+  CHECK( run(3, 0, N, 20) == pooled );
+}
@@ -4,6 +4,13 @@
 
 #include "../src/event.h"
 
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <numeric>
+#include <string>
+#include <vector>
+
 #include "catch.hpp"
 #include "util.h"
 
@@ -15,15 +22,20 @@ using namespace trento;
 TEST_CASE( "event" ) {
   // Check Event class results against equivalent (but slower) methods.
 
-  // Repeat for p == 0, p < 0, p > 0.
+  // Repeat for each deposition kernel and p == 0, p < 0, p > 0, and the
+  // specialized values of p.
   auto pplus = .5 + .49*random::canonical<>();
   auto pminus = -.5 + .49*random::canonical<>();
-  for (auto p : {0., pplus, pminus }) {
+  for (std::string deposition : {"direct", "separable", "stamp", "fft"}) {
+  for (auto p : {0., pplus, pminus, 1., .5, -1. }) {
     // Random physical params.
     auto norm = 1. + .5*random::canonical<>();
     auto xsec = 4. + 3.*random::canonical<>();
     auto nucleon_width = .5 + .2*random::canonical<>();
 
+    // Alternate the default r^n eccentricity weight with a fixed power.
+    auto radial_weight = (deposition == "separable") ? 3 : -1;
+
     // Effectively disable fluctuations to deterministically compute thickness.
     auto fluct = 1e12;
 
@@ -35,22 +47,40 @@ TEST_CASE( "event" ) {
     auto var_map = make_var_map({
         {"normalization", norm},
         {"reduced-thickness", p},
-        {"grid-max", grid_max},
-        {"grid-step", grid_step},
+        {"beam-energy", 2760.},
+        {"mean-coeff", 1.},
+        {"std-coeff", 3.},
+        {"skew-coeff", 0.},
+        {"skew-type", 1},
+        {"jacobian", 0.8},
+        {"xy-max", grid_max},
+        {"xy-step", grid_step},
+        {"eta-max", 0.},
+        {"eta-step", 0.5},
+        {"deposition", deposition},
         {"fluctuation",   fluct},
         {"cross-section", xsec},
         {"nucleon-width", nucleon_width},
+        {"ncoll", false},
+        {"collision-vertices", false},
+        {"stream-density", false},
+        {"no-density", false},
+        {"eta-observables", false},
+        {"harmonics", std::string{"1-3,5-8"}},
+        {"radial-weight", radial_weight},
     });
 
     Event event{var_map};
     NucleonProfile profile{var_map};
 
-    CHECK( event.reduced_thickness_grid().num_dimensions() == 2 );
-    CHECK( static_cast<int>(event.reduced_thickness_grid().shape()[0]) == grid_nsteps );
-    CHECK( static_cast<int>(event.reduced_thickness_grid().shape()[1]) == grid_nsteps );
+    const auto& grid = event.density_grid();
+    CHECK( grid.num_dimensions() == 3 );
+    CHECK( static_cast<int>(grid.shape()[0]) == grid_nsteps );
+    CHECK( static_cast<int>(grid.shape()[1]) == grid_nsteps );
+    CHECK( static_cast<int>(grid.shape()[2]) == 1 );
 
-    auto nucleusA = Nucleus::create("Pb");
-    auto nucleusB = Nucleus::create("Pb");
+    auto nucleusA = Nucleus::create("Pb", nucleon_width);
+    auto nucleusB = Nucleus::create("Pb", nucleon_width);
 
     // Sample impact param, nucleons, and participants.
     auto b = 4.*std::sqrt(random::canonical<>());
@@ -75,16 +105,21 @@ TEST_CASE( "event" ) {
     auto npart = count_part(*nucleusA) + count_part(*nucleusB);
     CHECK( npart == event.npart() );
 
-    // Compute TR grid the slow way -- switch the order of grid and nucleon loops.
-    boost::multi_array<double, 2> TR{boost::extents[grid_nsteps][grid_nsteps]};
+    // Compute TR grid the slow way -- switch the order of grid and nucleon
+    // loops, and evaluate the truncated Gaussian with std::exp.
+    Event::Grid TR{boost::extents[grid_nsteps][grid_nsteps]};
 
-    auto thickness = [&profile](const Nucleus& nucleus, double x, double y) {
+    auto rsq = profile.radius() * profile.radius();
+    auto tzero = 1./(2*M_PI*nucleon_width*nucleon_width);
+    auto thickness = [&](const Nucleus& nucleus, double x, double y) {
       auto t = 0.;
       for (const auto& n : nucleus) {
         if (n.is_participant()) {
           auto dx = n.x() - x;
           auto dy = n.y() - y;
-          t += profile.thickness(dx*dx + dy*dy);
+          auto dsq = dx*dx + dy*dy;
+          if (dsq <= rsq)
+            t += tzero*std::exp(-.5*dsq/(nucleon_width*nucleon_width));
         }
       }
       return t;
@@ -112,17 +147,77 @@ TEST_CASE( "event" ) {
     // Verify multiplicity.
     auto mult = std::pow(2*grid_max/grid_nsteps, 2) *
       std::accumulate(TR.origin(), TR.origin() + TR.num_elements(), 0.);
-    CHECK( mult == Approx(event.multiplicity()) );
+    auto approximate = (deposition == "stamp" || deposition == "fft");
+    auto eps = approximate ? 1e-3 : 1e-4;
+    CHECK( mult == Approx(event.multiplicity()).epsilon(eps) );
+
+    // Verify the observables against a direct evaluation on the event's own
+    // TR grid, which must agree to rounding.
+    {
+      auto sum = 0., xcm = 0., ycm = 0.;
+      for (auto iy = 0; iy < grid_nsteps; ++iy) {
+        for (auto ix = 0; ix < grid_nsteps; ++ix) {
+          double t = grid[iy][ix][0];
+          sum += t;
+          xcm += t*ix;
+          ycm += t*iy;
+        }
+      }
+      xcm /= sum;
+      ycm /= sum;
 
-    // Verify each grid element.
+      auto all_close = true;
+      for (std::size_t k = 0; k < event.harmonics().size(); ++k) {
+        auto n = event.harmonics()[k];
+        auto m = radial_weight < 0 ? n : radial_weight;
+        std::complex<double> moment{};
+        auto weight = 0.;
+        for (auto iy = 0; iy < grid_nsteps; ++iy) {
+          for (auto ix = 0; ix < grid_nsteps; ++ix) {
+            double t = grid[iy][ix][0];
+            if (t < 1e-12)
+              continue;
+            std::complex<double> z{ix - xcm, iy - ycm};
+            auto r = std::abs(z);
+            if (r == 0.)
+              continue;
+            moment += t*std::pow(r, m)*std::pow(z/r, n);
+            weight += t*std::pow(r, m);
+          }
+        }
+        // Relative error, except for e.g. e1 with weight r, which vanishes up
+        // to rounding.
+        auto expected = moment/weight;
+        all_close &= std::abs(expected - event.eccentricity_vectors()[k]) <
+                     1e-12*std::max(std::abs(expected), .1);
+      }
+      CHECK( all_close );
+    }
+
+    if (approximate) {
+      // Stamps shift each nucleon by up to grid_step/32, and the FFT engine
+      // interpolates the splatted positions, so compare the largest deviation
+      // to the peak.
+      Event::GridElement peak = 0., max_diff = 0.;
+      for (const auto* t1 = TR.origin(), * t2 = grid.origin();
+           t1 != TR.origin() + TR.num_elements();
+           ++t1, ++t2) {
+        peak = std::max(peak, *t1);
+        max_diff = std::max(max_diff, std::abs(*t1 - *t2));
+      }
+      CHECK( max_diff < (deposition == "fft" ? .03 : .02)*peak );
+      continue;
+    }
+
+    // Verify each grid element.  The direct kernel uses FastExp, hence the
+    // tolerance.
     auto all_correct = true;
-    for (const auto* t1 = TR.origin(),
-         * t2 = event.reduced_thickness_grid().origin();
+    for (const auto* t1 = TR.origin(), * t2 = grid.origin();
          t1 != TR.origin() + TR.num_elements();
          ++t1, ++t2) {
-      if (*t1 != Approx(*t2).epsilon(1e-5)) {
+      if (*t1 != Approx(*t2).epsilon(1e-4).margin(1e-8)) {
         all_correct = false;
-        WARN( "TR mismatch: " << *t1 << " != " << *t2 );
+        WARN( deposition << " TR mismatch: " << *t1 << " != " << *t2 );
         break;
       }
     }
@@ -141,13 +236,20 @@ TEST_CASE( "event" ) {
     xcm /= sum;
     ycm /= sum;
 
-    for (auto n = 2; n <= 5; ++n) {
+    const auto& harmonics = event.harmonics();
+    CHECK( harmonics == (std::vector<int>{1, 2, 3, 5, 6, 7, 8}) );
+    CHECK( event.eccentricity().size() == harmonics.size() );
+    CHECK( event.event_planes().size() == harmonics.size() );
+
+    for (std::size_t k = 0; k < harmonics.size(); ++k) {
+      auto n = harmonics[k];
+      auto m = radial_weight < 0 ? n : radial_weight;
       auto real = 0., imag = 0., weight = 0.;
       for (auto iy = 0; iy < grid_nsteps; ++iy) {
         for (auto ix = 0; ix < grid_nsteps; ++ix) {
           auto x = ix - xcm;
           auto y = iy - ycm;
-          auto w = TR[iy][ix] * std::pow(x*x + y*y, .5*n);
+          auto w = TR[iy][ix] * std::pow(x*x + y*y, .5*m);
           // compute exp(i*n*phi) the naive way
           auto phi = std::atan2(y, x);
           real += w*std::cos(n*phi);
@@ -156,21 +258,413 @@ TEST_CASE( "event" ) {
         }
       }
       auto ecc = std::sqrt(real*real + imag*imag) / weight;
-      CHECK( ecc == Approx(event.eccentricity().at(n)).epsilon(1e-6).margin(1e-6) );
+      CHECK( ecc == Approx(event.eccentricity()[k]).epsilon(1e-4).margin(1e-6) );
+      CHECK( std::abs(event.eccentricity_vectors()[k]) ==
+             Approx(event.eccentricity()[k]) );
+
+      // Compare event planes by the direction of exp(i*n*psi), since psi is
+      // only defined modulo 2*pi/n.
+      auto psi = event.event_planes()[k];
+      CHECK( std::cos(n*psi)*ecc == Approx(real/weight).margin(1e-5) );
+      CHECK( std::sin(n*psi)*ecc == Approx(imag/weight).margin(1e-5) );
     }
   }
+  }
 
   // test grid size when step size does not evenly divide width
   auto var_map = make_var_map({
       {"normalization", 1.},
       {"reduced-thickness", 0.},
-      {"grid-max", 10.},
-      {"grid-step", 0.3}
+      {"beam-energy", 2760.},
+      {"mean-coeff", 1.},
+      {"std-coeff", 3.},
+      {"skew-coeff", 0.},
+      {"skew-type", 1},
+      {"jacobian", 0.8},
+      {"xy-max", 10.},
+      {"xy-step", 0.3},
+      {"eta-max", 0.},
+      {"eta-step", 0.5},
+      {"deposition", std::string{"separable"}},
+      {"ncoll", false},
+      {"collision-vertices", false},
+      {"stream-density", false},
+      {"no-density", false},
+      {"eta-observables", false},
+      {"harmonics", std::string{"2-5"}},
+      {"radial-weight", -1},
+  });
+
+  Event event{var_map};
+
+  CHECK( event.density_grid().shape()[0] == 67 );
+  CHECK( event.density_grid().shape()[1] == 67 );
+
+  // unknown deposition kernel
+  var_map.at("deposition").value() = std::string{"none"};
+  CHECK_THROWS_AS( Event{var_map}, std::invalid_argument );
+  var_map.at("deposition").value() = std::string{"separable"};
+
+  // harmonic lists are sorted and deduplicated
+  var_map.at("harmonics").value() = std::string{"4,2-3, 3"};
+  CHECK( Event{var_map}.harmonics() == (std::vector<int>{2, 3, 4}) );
+
+  // up to the highest order
+  var_map.at("harmonics").value() = std::string{"1-20"};
+  CHECK( Event{var_map}.harmonics().back() == 20 );
+
+  // invalid harmonic lists
+  for (std::string harmonics : {"", "0-2", "3-2", "2,x", "2-", "2-3-4",
+                                "2-21", "1-2147483647", "99999999999"}) {
+    var_map.at("harmonics").value() = harmonics;
+    CHECK_THROWS_AS( Event{var_map}, std::invalid_argument );
+  }
+}
+
+TEST_CASE( "streamed density" ) {
+  // A streamed 3D density must match the stored one row by row.
+  auto var_map = make_var_map({
+      {"normalization", 1.},
+      {"reduced-thickness", 0.},
+      {"beam-energy", 2760.},
+      {"mean-coeff", 1.},
+      {"std-coeff", 3.},
+      {"skew-coeff", 5.},
+      {"skew-type", 1},
+      {"jacobian", 0.8},
+      {"xy-max", 9.},
+      {"xy-step", 0.3},
+      {"eta-max", 3.},
+      {"eta-step", 0.5},
+      {"exact-rapidity", false},
+      {"deposition", std::string{"separable"}},
+      {"fluctuation", 1.},
+      {"cross-section", 6.4},
+      {"nucleon-width", 0.5},
+      {"ncoll", false},
+      {"collision-vertices", false},
+      {"stream-density", false},
+      {"no-density", false},
+      {"eta-observables", false},
+      {"harmonics", std::string{"2-5"}},
+      {"radial-weight", -1},
+  });
+
+  Event stored{var_map};
+  var_map.at("stream-density").value() = true;
+  Event streamed{var_map};
+
+  CHECK_FALSE( stored.streams_density() );
+  CHECK( streamed.streams_density() );
+  CHECK( streamed.density_grid().num_elements() == 0 );
+  CHECK( streamed.density_shape() == stored.density_shape() );
+
+  NucleonProfile profile{var_map};
+  auto nucleusA = Nucleus::create("Pb", 0.5);
+  auto nucleusB = Nucleus::create("Pb", 0.5);
+
+  // Repeat for a few events to check that nothing of the previous event is
+  // left behind.
+  for (int n = 0; n < 3; ++n) {
+    auto b = 8.*random::canonical<>();
+    nucleusA->sample_nucleons(+.5*b);
+    nucleusB->sample_nucleons(-.5*b);
+    for (auto&& A : *nucleusA)
+      for (auto&& B : *nucleusB)
+        profile.participate(A, B);
+
+    // Both events must draw the same fluctuations.
+    random::engine.seek(static_cast<std::uint32_t>(n), 1);
+    profile.reset_fluctuations();
+    stored.compute(*nucleusA, *nucleusB, profile);
+    random::engine.seek(static_cast<std::uint32_t>(n), 1);
+    profile.reset_fluctuations();
+    streamed.compute(*nucleusA, *nucleusB, profile);
+
+    const auto shape = stored.density_shape();
+    const auto row_size = shape[1]*shape[2];
+    int nrows = 0;
+    auto all_equal = true;
+    streamed.for_each_density_row(
+      [&](int iy, const Event::GridElement* row) {
+        all_equal &= (iy == nrows++);
+        all_equal &= std::equal(
+          row, row + row_size, &stored.density_grid()[iy][0][0]);
+      });
+    CHECK( nrows == static_cast<int>(shape[0]) );
+    CHECK( all_equal );
+  }
+}
+
+TEST_CASE( "eta observables" ) {
+  // Verify the eta-dependent observables against the stored 3D density.
+  auto var_map = make_var_map({
+      {"normalization", 1.},
+      {"reduced-thickness", 0.},
+      {"beam-energy", 2760.},
+      {"mean-coeff", 1.},
+      {"std-coeff", 3.},
+      {"skew-coeff", 5.},
+      {"skew-type", 1},
+      {"jacobian", 0.8},
+      {"xy-max", 9.},
+      {"xy-step", 0.3},
+      {"eta-max", 3.},
+      {"eta-step", 0.5},
+      {"exact-rapidity", false},
+      {"deposition", std::string{"separable"}},
+      {"fluctuation", 1.},
+      {"cross-section", 6.4},
+      {"nucleon-width", 0.5},
+      {"ncoll", false},
+      {"collision-vertices", false},
+      {"stream-density", false},
+      {"no-density", false},
+      {"eta-observables", true},
+      {"harmonics", std::string{"2-4"}},
+      {"radial-weight", -1},
+  });
+
+  Event event{var_map};
+  var_map.at("stream-density").value() = true;
+  Event streamed{var_map};
+  var_map.at("stream-density").value() = false;
+  var_map.at("no-density").value() = true;
+  Event no_density{var_map};
+
+  CHECK( event.has_eta_observables() );
+  CHECK( event.has_density() );
+  CHECK_FALSE( no_density.has_density() );
+  CHECK( no_density.density_grid().num_elements() == 0 );
+
+  NucleonProfile profile{var_map};
+  auto nucleusA = Nucleus::create("Pb", 0.5);
+  auto nucleusB = Nucleus::create("Pb", 0.5);
+
+  auto b = 4. + 4.*random::canonical<>();
+  nucleusA->sample_nucleons(+.5*b);
+  nucleusB->sample_nucleons(-.5*b);
+  for (auto&& A : *nucleusA)
+    for (auto&& B : *nucleusB)
+      profile.participate(A, B);
+
+  random::engine.seek(0, 1);
+  profile.reset_fluctuations();
+  event.compute(*nucleusA, *nucleusB, profile);
+  random::engine.seek(0, 1);
+  profile.reset_fluctuations();
+  no_density.compute(*nucleusA, *nucleusB, profile);
+
+  // The observables do not depend on whether the density is stored.
+  CHECK( event.eta_multiplicity() == no_density.eta_multiplicity() );
+  CHECK( event.eta_eccentricity() == no_density.eta_eccentricity() );
+
+  // A streamed density accumulates them while its rows are visited, and they
+  // are NaN until then.
+  random::engine.seek(0, 1);
+  profile.reset_fluctuations();
+  streamed.compute(*nucleusA, *nucleusB, profile);
+  CHECK( std::isnan(streamed.eta_multiplicity().front()) );
+  int nrows = 0;
+  streamed.for_each_density_row(
+    [&nrows](int, const Event::GridElement*) { ++nrows; });
+  CHECK( nrows == static_cast<int>(streamed.density_shape()[0]) );
+  CHECK( event.eta_multiplicity() == streamed.eta_multiplicity() );
+  CHECK( event.eta_eccentricity() == streamed.eta_eccentricity() );
+  CHECK( event.eta_decorrelation() == streamed.eta_decorrelation() );
+
+  // Later visits leave them alone, and the rows cannot be visited from within
+  // a visit, since they share a buffer.
+  streamed.for_each_density_row([](int, const Event::GridElement*) {});
+  CHECK( event.eta_multiplicity() == streamed.eta_multiplicity() );
+  CHECK_THROWS_AS(
+    streamed.for_each_density_row([&streamed](int, const Event::GridElement*) {
+      streamed.for_each_density_row([](int, const Event::GridElement*) {});
+    }),
+    std::logic_error );
+  CHECK( event.eta_multiplicity() == streamed.eta_multiplicity() );
+
+  const auto& grid = event.density_grid();
+  const auto nsteps = static_cast<int>(grid.shape()[0]);
+  const auto neta = static_cast<int>(grid.shape()[2]);
+  const auto mid = neta/2;
+  const auto dxy = event.dxy();
+  CHECK( static_cast<int>(event.eta_multiplicity().size()) == neta );
+
+  // The flat arrays, indexed like the grid.
+  const auto* eta_mult = event.eta_multiplicity().data();
+  const auto* eta_ecc = event.eta_eccentricity().data();
+  const auto* eta_psi = event.eta_event_planes().data();
+  const auto* eta_r = event.eta_decorrelation().data();
+
+  // The midrapidity slice is the reduced thickness.
+  CHECK( eta_mult[mid] == Approx(event.multiplicity()) );
+
+  // Center of mass of the midrapidity slice.
+  auto sum = 0., xcm = 0., ycm = 0.;
+  for (auto iy = 0; iy < nsteps; ++iy) {
+    for (auto ix = 0; ix < nsteps; ++ix) {
+      auto t = grid[iy][ix][mid];
+      sum += t;
+      xcm += t*ix;
+      ycm += t*iy;
+    }
+  }
+  xcm /= sum;
+  ycm /= sum;
+
+  const auto& harmonics = event.harmonics();
+  auto all_correct = true;
+  for (auto ieta = 0; ieta < neta; ++ieta) {
+    auto mult = 0.;
+    for (auto iy = 0; iy < nsteps; ++iy)
+      for (auto ix = 0; ix < nsteps; ++ix)
+        mult += grid[iy][ix][ieta];
+    all_correct &= (dxy*dxy*mult == Approx(eta_mult[ieta]));
+
+    for (std::size_t k = 0; k < harmonics.size(); ++k) {
+      auto n = harmonics[k];
+      auto offset = static_cast<int>(k)*neta;
+      auto real = 0., imag = 0., weight = 0.;
+      for (auto iy = 0; iy < nsteps; ++iy) {
+        for (auto ix = 0; ix < nsteps; ++ix) {
+          auto x = ix - xcm;
+          auto y = iy - ycm;
+          auto w = grid[iy][ix][ieta] * std::pow(x*x + y*y, .5*n);
+          auto phi = std::atan2(y, x);
+          real += w*std::cos(n*phi);
+          imag += w*std::sin(n*phi);
+          weight += w;
+        }
+      }
+      auto ecc = std::sqrt(real*real + imag*imag) / weight;
+      auto i = offset + ieta;
+      all_correct &= (ecc == Approx(eta_ecc[i]).epsilon(1e-4).margin(1e-6));
+      auto psi = eta_psi[i];
+      auto mirror_psi = eta_psi[offset + (neta - 1 - ieta)];
+      all_correct &= (eta_r[i] == Approx(std::cos(n*(psi - mirror_psi))));
+    }
+  }
+  CHECK( all_correct );
+
+  // At midrapidity, they are the usual eccentricities.
+  for (std::size_t k = 0; k < harmonics.size(); ++k) {
+    auto i = static_cast<int>(k)*neta + mid;
+    CHECK( eta_ecc[i] == Approx(event.eccentricity()[k]).epsilon(1e-4) );
+    CHECK( eta_r[i] == Approx(1.) );
+  }
+
+  // Asymmetric slices have no decorrelation.
+  var_map.at("eta-step").value() = 0.7;
+  Event asymmetric{var_map};
+  asymmetric.compute(*nucleusA, *nucleusB, profile);
+  CHECK( std::isnan(asymmetric.eta_decorrelation().front()) );
+}
+
+TEST_CASE( "binary collision density" ) {
+  // Verify the binary collision density against the product of the nucleon
+  // profiles normalized by Tpp, evaluated cell by cell.
+  auto nucleon_width = .4 + .3*random::canonical<>();
+  auto var_map = make_var_map({
+      {"normalization", 1.},
+      {"reduced-thickness", 0.},
+      {"beam-energy", 2760.},
+      {"mean-coeff", 1.},
+      {"std-coeff", 3.},
+      {"skew-coeff", 0.},
+      {"skew-type", 1},
+      {"jacobian", 0.8},
+      {"xy-max", 9.},
+      {"xy-step", 0.1},
+      {"eta-max", 0.},
+      {"eta-step", 0.5},
+      {"deposition", std::string{"separable"}},
+      {"fluctuation", 1.},
+      {"cross-section", 6.4},
+      {"nucleon-width", nucleon_width},
+      {"ncoll", true},
+      {"collision-vertices", true},
+      {"stream-density", false},
+      {"no-density", false},
+      {"eta-observables", false},
+      {"harmonics", std::string{"2-5"}},
+      {"radial-weight", -1},
   });
 
   Event event{var_map};
+  NucleonProfile profile{var_map};
+
+  auto nucleusA = Nucleus::create("Pb", nucleon_width);
+  auto nucleusB = Nucleus::create("Pb", nucleon_width);
+  nucleusA->sample_nucleons(+1.);
+  nucleusB->sample_nucleons(-1.);
+
+  // Deposit a few pairs at random impact parameters.
+  const auto max_bsq = std::pow(3.*nucleon_width, 2);
+  std::vector<std::pair<const Nucleon*, const Nucleon*>> pairs;
+  event.clear_collisions();
+  std::size_t iA = 0;
+  for (auto&& A : *nucleusA) {
+    std::size_t iB = 0;
+    for (auto&& B : *nucleusB) {
+      auto bsq = std::pow(A.x() - B.x(), 2) + std::pow(A.y() - B.y(), 2);
+      if (bsq < max_bsq && pairs.size() < 20) {
+        event.add_collision(iA, iB);
+        pairs.emplace_back(&A, &B);
+      }
+      ++iB;
+    }
+    ++iA;
+  }
+  CHECK( event.ncoll() == static_cast<int>(pairs.size()) );
+
+  // The grid and vertices are only built on request, and rebuilding them
+  // replaces the previous ones.
+  event.compute_collisions(*nucleusA, *nucleusB, profile);
+  event.compute_collisions(*nucleusA, *nucleusB, profile);
+
+  // One vertex (midpoint, impact parameter) per pair.
+  const auto& vertices = event.collision_vertices();
+  REQUIRE( vertices.size() == 3*pairs.size() );
+  for (std::size_t i = 0; i < pairs.size(); ++i) {
+    const auto& A = *pairs[i].first;
+    const auto& B = *pairs[i].second;
+    CHECK( vertices[3*i] == Approx(.5*(A.x() + B.x())) );
+    CHECK( vertices[3*i+1] == Approx(.5*(A.y() + B.y())) );
+    CHECK( vertices[3*i+2] ==
+           Approx(std::hypot(A.x() - B.x(), A.y() - B.y())) );
+  }
+
+  const auto& grid = event.TAB_grid();
+  const auto nsteps = static_cast<int>(grid.shape()[0]);
+  const auto dxy = event.dxy();
+  const auto xymax = .5*nsteps*dxy;
+
+  auto sum = 0., peak = 0., max_diff = 0.;
+  for (auto iy = 0; iy < nsteps; ++iy) {
+    for (auto ix = 0; ix < nsteps; ++ix) {
+      auto x = (ix + .5)*dxy - xymax;
+      auto y = (iy + .5)*dxy - xymax;
+      auto expected = 0.;
+      for (const auto& pair : pairs) {
+        const auto& A = *pair.first;
+        const auto& B = *pair.second;
+        auto bsq = std::pow(A.x() - B.x(), 2) + std::pow(A.y() - B.y(), 2);
+        expected +=
+          profile.deterministic_thickness(
+            std::pow(A.x() - x, 2) + std::pow(A.y() - y, 2)) *
+          profile.deterministic_thickness(
+            std::pow(B.x() - x, 2) + std::pow(B.y() - y, 2)) /
+          profile.norm_Tpp(bsq);
+      }
+      sum += grid[iy][ix];
+      peak = std::max(peak, expected);
+      max_diff = std::max(max_diff, std::abs(expected - grid[iy][ix]));
+    }
+  }
 
-  CHECK( event.reduced_thickness_grid().num_dimensions() == 2 );
-  CHECK( event.reduced_thickness_grid().shape()[0] == 67 );
-  CHECK( event.reduced_thickness_grid().shape()[1] == 67 );
+  // Each collision is normalized to one, and the densities agree within the
+  // FastExp error of the reference.
+  CHECK( sum*dxy*dxy == Approx(pairs.size()).epsilon(1e-4) );
+  CHECK( max_diff < 1e-4*peak );
 }
@@ -0,0 +1,56 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// MIT License
+
+#include "../src/fast_math.h"
+
+#include <cmath>
+
+#include "catch.hpp"
+
+#include "../src/random.h"
+
+using namespace trento;
+
+TEST_CASE( "fast math" ) {
+  // A few ulp.
+  auto tolerance = 1e-15;
+
+  std::uniform_real_distribution<double> exp_dist{-700., 700.};
+  std::uniform_real_distribution<double> log10_dist{-300., 300.};
+  std::uniform_real_distribution<double> pow_dist{-3., 3.};
+
+  double worst_exp = 0., worst_log = 0., worst_pow = 0.;
+  for (int i = 0; i < 10000; ++i) {
+    auto x = exp_dist(random::engine);
+    worst_exp = std::max(worst_exp,
+      std::fabs(fast_exp(x)/std::exp(x) - 1.));
+
+    // Absolute error, since log crosses zero.
+    auto y = std::pow(10., log10_dist(random::engine));
+    worst_log = std::max(worst_log,
+      std::fabs(fast_log(y) - std::log(y))/std::fmax(std::fabs(std::log(y)), 1.));
+
+    // Thickness-like arguments and generalized mean-like exponents.
+    auto t = 100.*random::canonical<>();
+    auto p = pow_dist(random::engine);
+    worst_pow = std::max(worst_pow,
+      std::fabs(fast_pow(t, p)/std::pow(t, p) - 1.));
+  }
+
+  CHECK( worst_exp < tolerance );
+  CHECK( worst_log < tolerance );
+  CHECK( worst_pow < 10*tolerance );
+
+  // Exact at the special points.
+  CHECK( fast_exp(0.) == 1. );
+  CHECK( fast_log(1.) == 0. );
+
+  // Clamped to the normal range.
+  CHECK( fast_exp(-1e4) > 0. );
+  CHECK( std::isfinite(fast_exp(1e4)) );
+
+  // Finite (for masking) at zero.
+  CHECK( std::isfinite(fast_log(0.)) );
+  CHECK( std::isfinite(fast_pow(0., -2.)) );
+}
@@ -4,7 +4,9 @@
 
 #include "../src/nucleon.h"
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 #include "catch.hpp"
 #include "util.h"
@@ -24,6 +26,9 @@ TEST_CASE( "nucleon" ) {
       {"fluctuation",   fluct},
       {"cross-section", xsec},
       {"nucleon-width", width},
+      {"xy-step",       .2},
+      {"ncoll",         false},
+      {"collision-vertices", false},
   });
 
   NucleonProfile profile{var_map};
@@ -111,6 +116,9 @@ TEST_CASE( "nucleon" ) {
       {"fluctuation",   1e12},
       {"cross-section", xsec},
       {"nucleon-width", width},
+      {"xy-step",       .2},
+      {"ncoll",         false},
+      {"collision-vertices", false},
   });
 
   NucleonProfile no_fluct_profile{no_fluct_var_map};
@@ -123,8 +131,114 @@ TEST_CASE( "nucleon" ) {
         {"fluctuation",   1.},
         {"cross-section", 5.},
         {"nucleon-width", .1},
+        {"xy-step",       .2},
+        {"ncoll",         false},
+        {"collision-vertices", false},
     });
     NucleonProfile bad_profile{bad_var_map};
   }(),
   std::domain_error);
 }
+
+TEST_CASE( "batched participation" ) {
+  auto xsec = 4. + 3.*random::canonical<>();
+  auto width = .5 + .2*random::canonical<>();
+
+  auto var_map = make_var_map({
+      {"fluctuation",   1.},
+      {"cross-section", xsec},
+      {"nucleon-width", width},
+      {"xy-step",       .2},
+      {"ncoll",         false},
+      {"collision-vertices", false},
+  });
+
+  NucleonProfile profile{var_map};
+  auto bmax = profile.max_impact();
+
+  // A single nucleon at the origin against a block of nucleons at random
+  // min-bias impact parameters: the participating fraction of the block
+  // reproduces the cross section.
+  Proton A{};
+  A.sample_nucleons(0.);
+
+  constexpr std::size_t n = 1000;
+  std::vector<std::size_t> index(n, 0);
+  std::vector<double> x(n), y(n, 0.);
+  std::vector<unsigned char> hit(n);
+
+  Proton B{};
+  B.sample_nucleons(0.);
+
+  auto nev = 1000;
+  auto count = 0.;
+  for (auto i = 0; i < nev; ++i) {
+    for (auto& xi : x)
+      xi = bmax * std::sqrt(random::canonical<>());
+    count += profile.participate(A, 0, B, index.data(),
+                                 x.data(), y.data(), n, hit.data());
+  }
+
+  auto xsec_mc = M_PI*bmax*bmax * count/(nev*static_cast<double>(n));
+  CHECK( xsec_mc == Approx(xsec).epsilon(.02) );
+
+  // participants are marked in both views
+  CHECK( A.begin()->is_participant() );
+  CHECK( B.begin()->is_participant() );
+  CHECK( A.participant_data()[0] == 1 );
+  CHECK( B.participant_data()[0] == 1 );
+
+  // resampling resets them
+  A.sample_nucleons(0.);
+  CHECK( !A.begin()->is_participant() );
+  CHECK( A.participant_data()[0] == 0 );
+
+  // impact larger than max should never participate
+  for (auto& xi : x)
+    xi = bmax * (1. + random::canonical<>());
+  CHECK( profile.participate(A, 0, B, index.data(),
+                             x.data(), y.data(), n, hit.data()) == 0 );
+  CHECK( std::count(hit.begin(), hit.end(), 1) == 0 );
+}
+
+TEST_CASE( "stamp bank" ) {
+  auto width = .5 + .2*random::canonical<>();
+  auto dxy = .02 + .2*random::canonical<>();
+
+  auto var_map = make_var_map({
+      {"fluctuation",   1e12},
+      {"cross-section", 6.4},
+      {"nucleon-width", width},
+      {"xy-step",       dxy},
+      {"ncoll",         false},
+      {"collision-vertices", false},
+  });
+
+  NucleonProfile profile{var_map};
+  profile.fluctuate();
+
+  auto K = profile.stamp_half_width();
+  auto nphases = profile.stamp_phases();
+
+  // stamps reach beyond the truncation radius on both sides
+  CHECK( K*dxy > profile.radius() );
+
+  // each stamp is the Gaussian factor at its distances, which are measured
+  // from a point p/nphases cells past the center of cell K
+  bool all_correct = true;
+  for (auto p = 0; p < nphases; ++p) {
+    for (auto j = 0; j < 2*K + 2; ++j) {
+      auto d = (j - K - static_cast<double>(p)/nphases)*dxy;
+      if (profile.stamp_distance_sqr(p)[j] != Approx(d*d) ||
+          profile.stamp(p)[j] != Approx(std::exp(-.5*d*d/(width*width))))
+        all_correct = false;
+    }
+  }
+  CHECK( all_correct );
+
+  // the outer product times the prefactor is the thickness
+  auto dsq = profile.stamp_distance_sqr(3)[K + 2] +
+             profile.stamp_distance_sqr(7)[K - 1];
+  CHECK( profile.prefactor()*profile.stamp(3)[K + 2]*profile.stamp(7)[K - 1]
+         == Approx(profile.thickness(dsq)).epsilon(1e-4) );
+}
@@ -19,7 +19,7 @@
 using namespace trento;
 
 TEST_CASE( "proton" ) {
-  auto nucleus = Nucleus::create("p");
+  auto nucleus = Nucleus::create("p", .5);
 
   CHECK( dynamic_cast<Proton*>(nucleus.get()) != nullptr );
 
@@ -45,7 +45,7 @@ TEST_CASE( "proton" ) {
 }
 
 TEST_CASE( "deuteron" ) {
-  auto nucleus = Nucleus::create("d");
+  auto nucleus = Nucleus::create("d", .5);
 
   CHECK( dynamic_cast<Deuteron*>(nucleus.get()) != nullptr );
 
@@ -62,7 +62,7 @@ TEST_CASE( "deuteron" ) {
 }
 
 TEST_CASE( "lead nucleus" ) {
-  auto nucleus = Nucleus::create("Pb");
+  auto nucleus = Nucleus::create("Pb", .5);
 
   CHECK( dynamic_cast<WoodsSaxonNucleus*>(nucleus.get()) != nullptr );
 
@@ -100,8 +100,8 @@ TEST_CASE( "lead nucleus" ) {
 }
 
 TEST_CASE( "copper nucleus" ) {
-  auto nucleus = Nucleus::create("Cu");
-  auto def_nucleus = Nucleus::create("Cu2");
+  auto nucleus = Nucleus::create("Cu", .5);
+  auto def_nucleus = Nucleus::create("Cu2", .5);
 
   CHECK( dynamic_cast<WoodsSaxonNucleus*>(nucleus.get()) != nullptr );
   CHECK( dynamic_cast<DeformedWoodsSaxonNucleus*>(def_nucleus.get()) != nullptr );
@@ -115,8 +115,8 @@ TEST_CASE( "copper nucleus" ) {
 }
 
 TEST_CASE( "gold nucleus" ) {
-  auto nucleus = Nucleus::create("Au");
-  auto def_nucleus = Nucleus::create("Au2");
+  auto nucleus = Nucleus::create("Au", .5);
+  auto def_nucleus = Nucleus::create("Au2", .5);
 
   CHECK( dynamic_cast<WoodsSaxonNucleus*>(nucleus.get()) != nullptr );
   CHECK( dynamic_cast<DeformedWoodsSaxonNucleus*>(def_nucleus.get()) != nullptr );
@@ -130,7 +130,7 @@ TEST_CASE( "gold nucleus" ) {
 }
 
 TEST_CASE( "uranium nucleus" ) {
-  auto nucleus = Nucleus::create("U");
+  auto nucleus = Nucleus::create("U", .5);
 
   CHECK( dynamic_cast<DeformedWoodsSaxonNucleus*>(nucleus.get()) != nullptr );
 
@@ -167,12 +167,14 @@ TEST_CASE( "manual nucleus" ) {
     dataset.write(positions.data(), datatype);
   }
 
-  auto nucleus = Nucleus::create(temp.path.string());
+  auto nucleus = Nucleus::create(temp.path.string(), .5);
 
   CHECK( dynamic_cast<ManualNucleus*>(nucleus.get()) != nullptr );
 
-  CHECK( std::distance(nucleus->begin(), nucleus->end()) == A );
-  CHECK( std::distance(nucleus->cbegin(), nucleus->cend()) == A );
+  CHECK( std::distance(nucleus->begin(), nucleus->end()) ==
+       static_cast<std::ptrdiff_t>(A) );
+  CHECK( std::distance(nucleus->cbegin(), nucleus->cend()) ==
+       static_cast<std::ptrdiff_t>(A) );
 
   CHECK( nucleus->radius() == Approx(3.) );
 
@@ -198,7 +200,92 @@ TEST_CASE( "manual nucleus" ) {
   CHECK( nucleon->y() == Approx(-std::next(nucleon)->y()) );
   CHECK( nucleon->z() == Approx(-std::next(nucleon)->z()) );
 
-  CHECK_THROWS_AS( Nucleus::create("nonexistent.hdf"), std::invalid_argument );
+  CHECK_THROWS_AS( Nucleus::create("nonexistent.hdf", .5),
+                   std::invalid_argument );
+
+  // The small file is held entirely in memory.
+  CHECK( dynamic_cast<ManualNucleus&>(*nucleus).fully_cached() );
+}
+
+TEST_CASE( "manual nucleus blocks" ) {
+  // Configurations whose first nucleon is at radius index + 1, in chunks of 5.
+  constexpr hsize_t nconfigs = 40, A = 2, chunk = 5;
+  std::vector<float> positions(nconfigs*A*3, 0.);
+  for (hsize_t i = 0; i < nconfigs; ++i)
+    positions[3*A*i] = i + 1.;
+
+  temporary_path temp{".hdf5"};
+
+  {
+    auto dataspace = hdf5::make_dataspace(std::array<hsize_t, 3>{nconfigs, A, 3});
+    const auto& datatype = hdf5::type<float>();
+
+    H5::DSetCreatPropList proplist{};
+    const std::array<hsize_t, 3> chunk_dims = {chunk, A, 3};
+    proplist.setChunk(3, chunk_dims.data());
+
+    H5::H5File file{temp.path.string(), H5F_ACC_EXCL};
+
+    auto dataset = file.createDataSet("test", datatype, dataspace, proplist);
+    dataset.write(positions.data(), datatype);
+  }
+
+  // A zero-size cache holds blocks of one chunk, each used by two consecutive
+  // events (the block is given by the event number of the random engine).
+  auto nucleus = ManualNucleus::create(temp.path.string(), 0);
+  CHECK_FALSE( nucleus->fully_cached() );
+
+  // The config index of the first nucleon.
+  auto sample_index = [](Nucleus& n, std::uint32_t event) {
+    random::engine.seek(event, 0);
+    n.sample_nucleons(0.);
+    const auto& nucleon = *n.cbegin();
+    auto r = std::sqrt(std::pow(nucleon.x(), 2) + std::pow(nucleon.y(), 2) +
+                       std::pow(nucleon.z(), 2));
+    auto index = std::lround(r) - 1;
+    return std::fabs(r - static_cast<double>(index) - 1.) < 1e-5 ? index : -1;
+  };
+
+  // Every sample is a rotated configuration, and events move through the file.
+  std::vector<long> indices;
+  for (std::uint32_t event = 0; event < 200; ++event)
+    indices.push_back(sample_index(*nucleus, event));
+  std::map<long, int> counts;
+  for (const auto& index : indices)
+    ++counts[index/static_cast<long>(chunk)];
+  CHECK( counts.count(-1) == 0 );
+  CHECK( counts.rbegin()->first < static_cast<long>(nconfigs/chunk) );
+  CHECK( counts.size() > 2 );
+
+  // Events depend only on their event number: they are reproduced in any
+  // order, e.g. going back, jumping ahead, or by a new cache.
+  CHECK( sample_index(*nucleus, 10) == indices[10] );
+  CHECK( sample_index(*nucleus, 150) == indices[150] );
+  CHECK( sample_index(*nucleus, 11) == indices[11] );
+  nucleus.reset();
+  nucleus = ManualNucleus::create(temp.path.string(), 0);
+  CHECK( sample_index(*nucleus, 123) == indices[123] );
+
+  // A second nucleus from the same file shares the cache and its blocks.
+  auto other = ManualNucleus::create(temp.path.string(), 0);
+  CHECK( other->size() == A );
+  CHECK( sample_index(*other, 124) == indices[124] );
+
+  // An event that falls behind while the cache moves on keeps its block, and
+  // so does a nucleus sampling it meanwhile.
+  CHECK( sample_index(*nucleus, 180) == indices[180] );
+  CHECK( sample_index(*other, 125) == indices[125] );
+  auto third = ManualNucleus::create(temp.path.string(), 0);
+  CHECK( sample_index(*third, 125) == indices[125] );
+  CHECK( sample_index(*third, 20) == indices[20] );
+
+  // The blocks depend on the seed, so another seed draws from other chunks.
+  auto reseeded = ManualNucleus::create(temp.path.string(), 0, 1);
+  int nother = 0;
+  for (std::uint32_t event = 0; event < 200; ++event)
+    nother += (sample_index(*reseeded, event)/static_cast<long>(chunk) !=
+               indices[event]/static_cast<long>(chunk));
+  CHECK( nother > 100 );
 }
 
 #endif  // TRENTO_HDF5
@@ -309,6 +396,88 @@ TEST_CASE( "deformed woods-saxon sampling" ) {
   };
 
   CHECK( mean_ecc2(nucleus_def) > 2.*mean_ecc2(nucleus_sym) );
+
+  // The radius is invariant under the rotations, so check its mean square
+  // against a numerical integral of the deformed W-S dist.
+  int nevents = 500;
+  double r2_sum = 0.;
+  for (int n = 0; n < nevents; ++n) {
+    nucleus_def.sample_nucleons(0.);
+    for (const auto& nucleon : nucleus_def)
+      r2_sum += std::pow(nucleon.x(), 2) + std::pow(nucleon.y(), 2) +
+                std::pow(nucleon.z(), 2);
+  }
+
+  double numer = 0., denom = 0.;
+  for (int i = 0; i < 100; ++i) {
+    double cos_theta_sq = std::pow((i + .5)/100., 2);
+    double Y20 = std::sqrt(5./M_PI)/4. * (3.*cos_theta_sq - 1.);
+    double Y40 = 3./16./std::sqrt(M_PI) *
+                 (35.*cos_theta_sq*cos_theta_sq - 30.*cos_theta_sq + 3.);
+    double Reff = R * (1. + beta2*Y20 + beta4*Y40);
+    for (int j = 0; j < 1000; ++j) {
+      double r = (j + .5)*.015;
+      double f = r*r/(1. + std::exp((r - Reff)/a));
+      numer += r*r*f;
+      denom += f;
+    }
+  }
+
+  CHECK( r2_sum/nevents/static_cast<double>(A) ==
+         Approx(numer/denom).epsilon(.005) );
+
+  // The proposals follow the deformed dist closely, so nearly all are
+  // accepted (compared to ~10% for uniform proposals in a sphere).
+  CHECK( nucleus_def.acceptance_rate() > .95 );
+}
+
+TEST_CASE( "nucleus pool" ) {
+  auto generator = Nucleus::create("U", .5, 1.);
+  auto configs = std::make_shared<NucleusPool::Configs>();
+  for (std::size_t i = 0; i < 10; ++i)
+    NucleusPool::sample_config(*generator, 1, i, *configs);
+
+  NucleusPool pool{configs, *generator};
+  CHECK( pool.size() == generator->size() );
+  CHECK( pool.radius() == generator->radius() );
+  CHECK( pool.nconfigs() == 10 );
+  CHECK( pool.memory() == 10*238*3*sizeof(float) );
+
+  // Each configuration is reproducible from its index.
+  auto again = NucleusPool::Configs{};
+  NucleusPool::sample_config(*generator, 1, 3, again);
+  CHECK( std::equal(again.cbegin() + 3*3*238, again.cend(),
+                    configs->cbegin() + 3*3*238) );
+
+  // Sampled nuclei are recentred and rotated configurations from the pool,
+  // so the center of mass is at the offset and the radii are preserved.
+  random::engine.seed(1);
+  pool.sample_nucleons(1.);
+  double xcm = 0., ycm = 0., zcm = 0., r2 = 0.;
+  for (const auto& nucleon : pool) {
+    xcm += nucleon.x();
+    ycm += nucleon.y();
+    zcm += nucleon.z();
+    r2 += std::pow(nucleon.x() - 1., 2) + std::pow(nucleon.y(), 2) +
+          std::pow(nucleon.z(), 2);
+  }
+  CHECK( xcm/238 == Approx(1.) );
+  CHECK( std::fabs(ycm/238) < 1e-5 );
+  CHECK( std::fabs(zcm/238) < 1e-5 );
+
+  auto matches_config = false;
+  for (std::size_t i = 0; i < 10; ++i) {
+    double config_r2 = 0.;
+    for (std::size_t j = 3*238*i; j < 3*238*(i + 1); ++j)
+      config_r2 += std::pow((*configs)[j], 2);
+    matches_config = matches_config || r2 == Approx(config_r2);
+  }
+  CHECK( matches_config );
+  CHECK( pool.ndraws() == 1 );
+
+  CHECK_THROWS_AS(
+    NucleusPool(std::make_shared<NucleusPool::Configs>(), *generator),
+    std::invalid_argument );
 }
 
 TEST_CASE( "nuclear radius" ) {
@@ -329,7 +498,7 @@ TEST_CASE( "minimum distance" ) {
   for (const auto& species : {"Pb", "U"}) {
     for (auto repeat = 0; repeat < 10; ++repeat) {
       const auto target_dmin = .2 + .4*random::canonical<>();
-      auto nucleus = Nucleus::create("Pb", target_dmin);
+      auto nucleus = Nucleus::create(species, .5, target_dmin);
       nucleus->sample_nucleons(10*random::canonical<>());
       auto dminsq = 100.;
       for (auto n1 = nucleus->cbegin(); n1 != nucleus->cend(); ++n1) {
@@ -347,6 +516,73 @@ TEST_CASE( "minimum distance" ) {
   }
 }
 
+namespace {
+
+// Nucleons uniform in a cube, placed with the minimum distance check of
+// MinDistNucleus.  Compares each check with a brute-force scan.
+class BoxNucleus : public MinDistNucleus {
+ public:
+  BoxNucleus(std::size_t A, double dmin, double side)
+      : MinDistNucleus(A, dmin), dmin_(dmin), side_(side) {}
+
+  virtual double radius() const override { return side_; }
+
+  int nchecks = 0, nrejected = 0, nmismatched = 0;
+
+ private:
+  virtual void sample_nucleons_impl() override {
+    for (iterator nucleon = begin(); nucleon != end(); ++nucleon) {
+      bool too_close;
+      do {
+        set_nucleon_position(nucleon, side_*(random::canonical<>() - .5),
+                                      side_*(random::canonical<>() - .5),
+                                      side_*(random::canonical<>() - .5));
+        too_close = false;
+        for (auto other = cbegin(); other != nucleon; ++other) {
+          auto dx = nucleon->x() - other->x();
+          auto dy = nucleon->y() - other->y();
+          auto dz = nucleon->z() - other->z();
+          too_close = too_close || dx*dx + dy*dy + dz*dz < dmin_*dmin_;
+        }
+        ++nchecks;
+        nrejected += too_close;
+        nmismatched += too_close != is_too_close(nucleon);
+      } while (too_close);
+    }
+  }
+
+  const double dmin_, side_;
+};
+
+}  // unnamed namespace
+
+TEST_CASE( "minimum distance hash" ) {
+  // The cube spans 2.5 periods of the spatial hash (16 cells of side dmin),
+  // so distant nucleons share buckets and neighbouring cells wrap around.
+  constexpr auto dmin = .7;
+  BoxNucleus nucleus{1000, dmin, 40*dmin};
+
+  for (auto repeat = 0; repeat < 3; ++repeat) {
+    nucleus.sample_nucleons(0.);
+
+    auto dminsq = 100.;
+    for (auto n1 = nucleus.cbegin(); n1 != nucleus.cend(); ++n1) {
+      for (auto n2 = n1 + 1; n2 != nucleus.cend(); ++n2) {
+        auto dx = n1->x() - n2->x();
+        auto dy = n1->y() - n2->y();
+        auto dz = n1->z() - n2->z();
+        dminsq = std::fmin(dx*dx + dy*dy + dz*dz, dminsq);
+      }
+    }
+    CHECK( std::sqrt(dminsq) >= dmin );
+  }
+
+  // Every check agrees with the brute-force scan, and some reject.
+  CHECK( nucleus.nmismatched == 0 );
+  CHECK( nucleus.nrejected > 0 );
+  CHECK( nucleus.nchecks > 3000 );
+}
+
 TEST_CASE( "unknown nucleus species" ) {
-  CHECK_THROWS_AS( Nucleus::create("hello"), std::invalid_argument );
+  CHECK_THROWS_AS( Nucleus::create("hello", .5), std::invalid_argument );
 }
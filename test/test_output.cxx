@@ -4,6 +4,9 @@
 
 #include "../src/output.h"
 
+#include <array>
+#include <sstream>
+
 #include "catch.hpp"
 #include "util.h"
 
@@ -20,19 +23,35 @@ TEST_CASE( "output" ) {
   auto var_map = make_var_map({
     {"normalization", 1.},
     {"reduced-thickness", 0.},
-    {"grid-max", 9.},
-    {"grid-step", 0.3},
+    {"beam-energy", 2760.},
+    {"mean-coeff", 1.},
+    {"std-coeff", 3.},
+    {"skew-coeff", 0.},
+    {"skew-type", 1},
+    {"jacobian", 0.8},
+    {"xy-max", 9.},
+    {"xy-step", 0.3},
+    {"eta-max", 0.},
+    {"eta-step", 0.5},
+    {"deposition", std::string{"separable"}},
     {"fluctuation", 1.},
     {"cross-section", 6.4},
-    {"nucleon-width", 0.5}
+    {"nucleon-width", 0.5},
+    {"ncoll", false},
+    {"collision-vertices", false},
+    {"stream-density", false},
+    {"no-density", false},
+    {"eta-observables", false},
+    {"harmonics", std::string{"2-5"}},
+    {"radial-weight", -1}
   });
 
   // create a test event
   Event event{var_map};
   NucleonProfile profile{var_map};
 
-  auto nucleusA = Nucleus::create("Pb");
-  auto nucleusB = Nucleus::create("Pb");
+  auto nucleusA = Nucleus::create("Pb", 0.5);
+  auto nucleusB = Nucleus::create("Pb", 0.5);
 
   auto b = 4.*std::sqrt(random::canonical<>());
   nucleusA->sample_nucleons(+.5*b);
@@ -90,10 +109,10 @@ TEST_CASE( "output" ) {
     CHECK( impact == Approx(b) );
     CHECK( npart == event.npart() );
     CHECK( mult == Approx(event.multiplicity()) );
-    CHECK( e2 == Approx(event.eccentricity().at(2)) );
-    CHECK( e3 == Approx(event.eccentricity().at(3)) );
-    CHECK( e4 == Approx(event.eccentricity().at(4)) );
-    CHECK( e5 == Approx(event.eccentricity().at(5)) );
+    CHECK( e2 == Approx(event.eccentricity()[0]) );
+    CHECK( e3 == Approx(event.eccentricity()[1]) );
+    CHECK( e4 == Approx(event.eccentricity()[2]) );
+    CHECK( e5 == Approx(event.eccentricity()[3]) );
 
     // verify the end character is really the end of file
     CHECK( end == std::char_traits<char>::eof() );
@@ -149,24 +168,33 @@ TEST_CASE( "output" ) {
       CHECK( line.substr(0, 10) == "# mult  = " );
       CHECK( std::stod(line.substr(10)) == Approx(event.multiplicity()) );
 
-      for (const auto& ecc : event.eccentricity()) {
+      for (std::size_t k = 0; k < event.harmonics().size(); ++k) {
         std::getline(ifs, line);
-        CHECK( line.substr(0, 10) == ("# e" + std::to_string(ecc.first) + "    = ") );
-        CHECK( std::stod(line.substr(10)) == Approx(ecc.second) );
+        CHECK( line.substr(0, 10) ==
+               ("# e" + std::to_string(event.harmonics()[k]) + "    = ") );
+        CHECK( std::stod(line.substr(10)) == Approx(event.eccentricity()[k]) );
+      }
+
+      for (std::size_t k = 0; k < event.harmonics().size(); ++k) {
+        std::getline(ifs, line);
+        CHECK( line.substr(0, 12) ==
+               ("# psi" + std::to_string(event.harmonics()[k]) + "    = ") );
+        CHECK( std::stod(line.substr(12)) == Approx(event.event_planes()[k]) );
       }
 
       // read the grid back in and check each element
-      const auto* iter = event.reduced_thickness_grid().origin();
+      const auto& grid = event.density_grid();
+      const auto* iter = grid.origin();
+      const auto* grid_end = grid.origin() + grid.num_elements();
       double check;
-      bool all_correct = false;
-      while (ifs >> check)
-        all_correct = (check == Approx(*(iter++))) || all_correct;
+      bool all_correct = true;
+      while (iter != grid_end && ifs >> check)
+        all_correct = (check == Approx(*(iter++))) && all_correct;
       CHECK( all_correct );
 
-      // verify that all grid elements were checked
-      const auto* grid_end = event.reduced_thickness_grid().origin() +
-                             event.reduced_thickness_grid().num_elements();
+      // verify that all grid elements were checked and nothing is left over
       CHECK( iter == grid_end );
+      CHECK_FALSE( ifs >> check );
     }
 
     {
@@ -205,44 +233,53 @@ TEST_CASE( "output" ) {
       auto name = file.getObjnameByIdx(0);
       CHECK( name == "event_0" );
 
-      auto dataset = file.openDataSet(name);
+      auto group = file.openGroup(name);
+      auto dataset = file.openDataSet(name + "/matter_density");
 
       // read back in the event grid to another array
-      Event::Grid grid_check{event.reduced_thickness_grid()};
-      dataset.read(grid_check.data(), H5::PredType::NATIVE_DOUBLE);
+      const auto& grid = event.density_grid();
+      Event::Grid3D grid_check{grid};
+      dataset.read(grid_check.data(), hdf5::type<Event::GridElement>());
 
       // verify each grid element
       auto grid_correct = std::equal(
         grid_check.origin(),
         grid_check.origin() + grid_check.num_elements(),
-        event.reduced_thickness_grid().origin(),
-        [](const double& value_check, const double& value) {
+        grid.origin(),
+        [](const Event::GridElement& value_check,
+           const Event::GridElement& value) {
           return value_check == Approx(value);
         }
       );
       CHECK( grid_correct );
 
-      // verify attributes
+      // verify attributes, which belong to the event group
       double double_check;
       int int_check;
 
-      dataset.openAttribute("b").read(H5::PredType::NATIVE_DOUBLE, &double_check);
+      group.openAttribute("b").read(H5::PredType::NATIVE_DOUBLE, &double_check);
       CHECK( double_check == Approx(b) );
 
-      dataset.openAttribute("npart").read(H5::PredType::NATIVE_INT, &int_check);
+      group.openAttribute("npart").read(H5::PredType::NATIVE_INT, &int_check);
       CHECK( int_check == event.npart() );
 
-      dataset.openAttribute("mult").read(H5::PredType::NATIVE_DOUBLE, &double_check);
+      group.openAttribute("mult").read(H5::PredType::NATIVE_DOUBLE, &double_check);
       CHECK( double_check == Approx(event.multiplicity()) );
 
-      for (const auto& ecc : event.eccentricity()) {
-        dataset.openAttribute("e" + std::to_string(ecc.first))
+      for (std::size_t k = 0; k < event.harmonics().size(); ++k) {
+        const auto n = std::to_string(event.harmonics()[k]);
+        group.openAttribute("e" + n)
+          .read(H5::PredType::NATIVE_DOUBLE, &double_check);
+        CHECK( double_check == Approx(event.eccentricity()[k]) );
+        group.openAttribute("psi" + n)
           .read(H5::PredType::NATIVE_DOUBLE, &double_check);
-        CHECK( double_check == Approx(ecc.second) );
+        CHECK( double_check == Approx(event.event_planes()[k]) );
       }
 
 #if H5_VERSION_GE(1, 8, 14)  // causes memory leak on earlier versions
-      CHECK( dataset.getNumAttrs() == 7 );
+      // b, npart, ncoll, mult, dxy, deta, Ny, Nx, Nz, and e, psi per harmonic
+      CHECK( group.getNumAttrs() == 9 + 2*static_cast<int>(
+               event.harmonics().size()) );
 #endif
     }
 
@@ -268,3 +305,116 @@ TEST_CASE( "output" ) {
   }
 #endif  // TRENTO_HDF5
 }
+
+TEST_CASE( "streamed output" ) {
+  // A streamed 3D density must be written exactly as the stored one.
+  auto var_map = make_var_map({
+    {"normalization", 1.},
+    {"reduced-thickness", 0.},
+    {"beam-energy", 2760.},
+    {"mean-coeff", 1.},
+    {"std-coeff", 3.},
+    {"skew-coeff", 5.},
+    {"skew-type", 1},
+    {"jacobian", 0.8},
+    {"xy-max", 9.},
+    {"xy-step", 0.3},
+    {"eta-max", 3.},
+    {"eta-step", 0.5},
+    {"exact-rapidity", false},
+    {"deposition", std::string{"separable"}},
+    {"fluctuation", 1.},
+    {"cross-section", 6.4},
+    {"nucleon-width", 0.5},
+    {"ncoll", false},
+    {"collision-vertices", false},
+    {"stream-density", false},
+    {"no-density", false},
+    {"eta-observables", false},
+    {"harmonics", std::string{"2-5"}},
+    {"radial-weight", -1}
+  });
+
+  Event stored{var_map};
+  var_map.at("stream-density").value() = true;
+  Event streamed{var_map};
+  NucleonProfile profile{var_map};
+
+  auto nucleusA = Nucleus::create("Pb", 0.5);
+  auto nucleusB = Nucleus::create("Pb", 0.5);
+
+  auto b = 4.*std::sqrt(random::canonical<>());
+  nucleusA->sample_nucleons(+.5*b);
+  nucleusB->sample_nucleons(-.5*b);
+
+  for (auto&& A : *nucleusA)
+    for (auto&& B : *nucleusB)
+      profile.participate(A, B);
+
+  // Both events must draw the same fluctuations.
+  random::engine.seek(0, 1);
+  profile.reset_fluctuations();
+  stored.compute(*nucleusA, *nucleusB, profile);
+  random::engine.seek(0, 1);
+  profile.reset_fluctuations();
+  streamed.compute(*nucleusA, *nucleusB, profile);
+
+  REQUIRE( streamed.streams_density() );
+  const auto& grid = stored.density_grid();
+  REQUIRE( grid.num_elements() > 0 );
+
+  SECTION( "text" ) {
+    temporary_path temp_stored{}, temp_streamed{};
+    auto write = [&b](const Event& event, const fs::path& path) {
+      Output{make_var_map({
+        {"quiet", true},
+        {"no-header", false},
+        {"number-events", 1},
+        {"output", path}
+      })}(0, b, event);
+    };
+    write(stored, temp_stored.path);
+    write(streamed, temp_streamed.path);
+
+    auto read = [](const fs::path& path) {
+      fs::ifstream ifs{path/"0.dat"};
+      std::ostringstream contents{};
+      contents << ifs.rdbuf();
+      return contents.str();
+    };
+    auto contents = read(temp_streamed.path);
+    CHECK( contents.size() > grid.num_elements() );
+    CHECK( contents == read(temp_stored.path) );
+  }
+
+#ifdef TRENTO_HDF5
+  SECTION( "hdf5" ) {
+    temporary_path temp{".hdf5"};
+    Output{make_var_map({
+      {"quiet", true},
+      {"number-events", 1},
+      {"output", temp.path}
+    })}(0, b, streamed);
+
+    H5::H5File file{temp.path.string(), H5F_ACC_RDONLY};
+    auto dataset = file.openDataSet("event_0/matter_density");
+
+    // The dataset has the full shape but is chunked by rows.
+    std::array<hsize_t, 3> shape, chunk;
+    dataset.getSpace().getSimpleExtentDims(shape.data());
+    dataset.getCreatePlist().getChunk(3, chunk.data());
+    CHECK( std::equal(shape.begin(), shape.end(), grid.shape()) );
+    CHECK( chunk[0] == 1 );
+    CHECK( chunk[1] == shape[1] );
+    CHECK( chunk[2] == shape[2] );
+
+    Event::Grid3D grid_check{grid};
+    std::fill_n(grid_check.data(), grid_check.num_elements(),
+                Event::GridElement{-1});
+    dataset.read(grid_check.data(), hdf5::type<Event::GridElement>());
+    CHECK( std::equal(grid_check.origin(),
+                      grid_check.origin() + grid_check.num_elements(),
+                      grid.origin()) );
+  }
+#endif  // TRENTO_HDF5
+}
@@ -0,0 +1,101 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#include "../src/radial_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace trento;
+
+TEST_CASE( "radial sampler" ) {
+  // Density r^2 on [0, 1]: the CDF is r^3, so u = r^3 is uniform.
+  RadialSampler cubic{[](double r) { return r*r; }, 1.};
+
+  // The table reproduces the exact inverse CDF u^(1/3), i.e. the CDF at the
+  // table value is the probability, and is monotonic.
+  auto max_err = 0., prev = 0.;
+  auto monotonic = true;
+  for (auto i = 1; i < 100000; ++i) {
+    auto u = i/100000.;
+    auto r = cubic(u);
+    max_err = std::fmax(max_err, std::fabs(r*r*r - u));
+    monotonic = monotonic && r >= prev;
+    prev = r;
+  }
+  CHECK( max_err < 1e-6 );
+  CHECK( monotonic );
+  CHECK( cubic(0.) == 0. );
+  CHECK( cubic(1.) == Approx(1.) );
+
+  // Sorted samples are sorted, and both samplers are uniform in r^3: check a
+  // histogram of r^3 and the mean of each order statistic, k/(n+1).
+  constexpr std::size_t n = 50, nbins = 10;
+  constexpr int nevents = 20000;
+  std::vector<double> r(n);
+  std::vector<double> order_mean(n, 0.);
+  std::vector<int> sorted_hist(nbins, 0), hist(nbins, 0);
+  auto sorted = true;
+  for (auto event = 0; event < nevents; ++event) {
+    cubic.sample_sorted(r.data(), n);
+    for (std::size_t k = 0; k < n; ++k) {
+      sorted = sorted && (k == 0 || r[k] >= r[k-1]);
+      order_mean[k] += r[k]*r[k]*r[k]/nevents;
+      ++sorted_hist[std::min(static_cast<std::size_t>(nbins*r[k]*r[k]*r[k]),
+                             nbins - 1)];
+    }
+    cubic.sample(r.data(), n);
+    for (std::size_t k = 0; k < n; ++k)
+      ++hist[std::min(static_cast<std::size_t>(nbins*r[k]*r[k]*r[k]),
+                      nbins - 1)];
+  }
+  CHECK( sorted );
+
+  auto order_ok = true;
+  for (std::size_t k = 0; k < n; ++k)
+    order_ok = order_ok &&
+      order_mean[k] == Approx((k + 1.)/(n + 1.)).epsilon(.02);
+  CHECK( order_ok );
+
+  const auto expected = static_cast<double>(n)*nevents/nbins;
+  for (std::size_t bin = 0; bin < nbins; ++bin) {
+    CHECK( sorted_hist[bin] == Approx(expected).epsilon(.02) );
+    CHECK( hist[bin] == Approx(expected).epsilon(.02) );
+  }
+
+  // Woods-Saxon: the CDF at the inverse is the probability.
+  const auto R = 6.6, a = .5, rmax = R + 10.*a;
+  auto woods_saxon = [R, a](double r) { return r*r/(1. + std::exp((r-R)/a)); };
+  RadialSampler ws{woods_saxon, rmax};
+  auto integrate = [&woods_saxon](double rhi) {
+    const auto nsteps = 20000;
+    const auto h = rhi/nsteps;
+    auto sum = 0.;
+    for (auto j = 0; j < nsteps; ++j)
+      sum += woods_saxon((j + .5)*h);
+    return sum*h;
+  };
+  const auto norm = integrate(rmax);
+  auto max_cdf_err = 0.;
+  for (auto u = .01; u < 1.; u += .01)
+    max_cdf_err = std::fmax(max_cdf_err, std::fabs(integrate(ws(u))/norm - u));
+  CHECK( max_cdf_err < 1e-6 );
+
+  // Also in the exponential tail, relative to the remaining probability.
+  for (auto q : {1e-3, 1e-4, 1e-5})
+    CHECK( 1. - integrate(ws(1. - q))/norm == Approx(q).epsilon(.01) );
+
+  CHECK_THROWS_AS( RadialSampler([](double) { return 0.; }, 1.),
+                   std::invalid_argument );
+  CHECK_THROWS_AS( RadialSampler([](double r) { return r; }, 0.),
+                   std::invalid_argument );
+  CHECK_THROWS_AS( RadialSampler([](double r) { return r; }, 1., 7),
+                   std::invalid_argument );
+  CHECK_NOTHROW( RadialSampler([](double r) { return r; }, 1., 8) );
+}
@@ -0,0 +1,71 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// MIT License
+
+#include "../src/random.h"
+
+#include <vector>
+
+#include "catch.hpp"
+
+using namespace trento;
+
+TEST_CASE( "philox engine" ) {
+  using random::Philox;
+
+  // known-answer tests from the Random123 reference implementation
+  CHECK( (Philox::bijection({{0, 0, 0, 0}}, {{0, 0}}) ==
+          std::array<std::uint32_t, 4>{{
+            0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}}) );
+  CHECK( (Philox::bijection(
+            {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}},
+            {{0xffffffff, 0xffffffff}}) ==
+          std::array<std::uint32_t, 4>{{
+            0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}}) );
+  CHECK( (Philox::bijection(
+            {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}},
+            {{0xa4093822, 0x299f31d0}}) ==
+          std::array<std::uint32_t, 4>{{
+            0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}}) );
+
+  auto draw = [](Philox& engine, std::size_t n) {
+    std::vector<Philox::result_type> values(n);
+    for (auto&& v : values)
+      v = engine();
+    return values;
+  };
+
+  Philox engine{12345};
+
+  // seeking to a stream always restarts it
+  engine.seek(7, 2);
+  auto stream = draw(engine, 11);
+  engine.seek(3, 0);
+  draw(engine, 5);
+  engine.seek(7, 2);
+  CHECK( draw(engine, 11) == stream );
+
+  // discard skips ahead within a stream
+  engine.seek(7, 2);
+  engine.discard(4);
+  CHECK( engine() == stream[4] );
+
+  // different events, tries, streams and keys give different numbers
+  engine.seek(8, 2);
+  CHECK( draw(engine, 11) != stream );
+  engine.seek(7, 3);
+  CHECK( draw(engine, 11) != stream );
+  engine.seek(7, 2, 1);
+  CHECK( draw(engine, 11) != stream );
+  Philox other{54321};
+  other.seek(7, 2);
+  CHECK( draw(other, 11) != stream );
+
+  // crude uniformity check of the canonical doubles
+  engine.seek(0, 0);
+  auto n = 100000;
+  auto sum = 0.;
+  for (auto i = 0; i < n; ++i)
+    sum += std::generate_canonical<double, 53>(engine);
+  CHECK( sum/n == Approx(.5).epsilon(.01) );
+}
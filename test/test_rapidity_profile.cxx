@@ -0,0 +1,82 @@
+// TRENTO: Reduced Thickness Event-by-event Nuclear Topology
+// Copyright 2015 Jonah E. Bernhard, J. Scott Moreland
+// TRENTO3D: Three-dimensional extension of TRENTO by Weiyao Ke
+// MIT License
+
+#include "../src/rapidity_profile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "catch.hpp"
+
+#include "../src/random.h"
+
+using namespace trento;
+
+TEST_CASE( "rapidity profile table" ) {
+  auto skew_max = 1. + 9.*random::canonical<>();
+
+  cumulant_generating exact{}, tabulated{};
+  tabulated.tabulate(skew_max, 1001);
+
+  // Tabulated shapes agree with the FFT for random mean, std and skew, both
+  // inside the table and (exactly, by fallback) outside.
+  // Skew values are generally between the tabulated nodes.
+  for (auto skew_frac : {-.99, -.3, 0., .45, .99, 1.5, -2.}) {
+    skew_frac += 1e-3*random::canonical<>();
+    auto mean = 2.*random::canonical<>() - 1.;
+    auto std = .5 + 3.*random::canonical<>();
+    auto skew = skew_frac*skew_max;
+    exact.calculate_dsdy(mean, std, skew);
+    tabulated.calculate_dsdy(mean, std, skew);
+
+    auto peak = 0., max_diff = 0.;
+    for (auto y = -8.; y <= 8.; y += .05) {
+      auto e = exact.interp_dsdy(y);
+      peak = std::max(peak, std::fabs(e));
+      max_diff = std::max(max_diff, std::fabs(e - tabulated.interp_dsdy(y)));
+    }
+
+    CHECK( peak > 0. );
+    if (std::fabs(skew_frac) > 1.)
+      CHECK( max_diff == 0. );
+    else
+      CHECK( max_diff < 1e-5*peak );
+  }
+}
+
+TEST_CASE( "rapidity profile plan" ) {
+  auto etamax = 2. + 6.*random::canonical<>();
+  auto deta = .05 + .2*random::canonical<>();
+  fast_eta2y eta2y{.8, etamax, deta};
+
+  const auto& y = eta2y.rapidity_plan();
+  const auto& J = eta2y.Jacobian_plan();
+  auto neta = static_cast<std::size_t>(std::ceil(2.*etamax/deta) + 1);
+  REQUIRE( y.size() == neta );
+  REQUIRE( J.size() == neta );
+
+  // the plan is the transformation at the grid nodes
+  for (std::size_t i = 0; i + 1 < neta; ++i) {
+    auto eta = -etamax + i*deta;
+    CHECK( y[i] == Approx(eta2y.rapidity(eta)).margin(1e-12) );
+    CHECK( J[i] == Approx(eta2y.Jacobian(eta)).margin(1e-12) );
+  }
+
+  // the batched profile interpolation agrees with the scalar one
+  cumulant_generating cgf{};
+  cgf.tabulate(3., 101);
+  cgf.calculate_dsdy(.5, 1. + random::canonical<>(), 2.*random::canonical<>());
+
+  auto scale = 1. + random::canonical<>();
+  std::vector<double> out(neta);
+  cgf.interp_dsdy(y.data(), neta, J.data(), scale, out.data());
+
+  bool all_correct = true;
+  for (std::size_t i = 0; i < neta; ++i)
+    if (out[i] != Approx(scale*J[i]*cgf.interp_dsdy(y[i])).margin(1e-14))
+      all_correct = false;
+  CHECK( all_correct );
+}
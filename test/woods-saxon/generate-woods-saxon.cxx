@@ -3,7 +3,8 @@
 #include <random>
 #include <string>
 
-// Generate Woods-Saxon numbers using the same method as in actual trento code.
+// Generate Woods-Saxon numbers from a piecewise linear approximation, as a
+// reference for the sampler in the actual trento code.
 
 int main(int /* argc */, char* argv[]) {
   double R;